@@ -1,4 +1,5 @@
 #include <math.h>
+#include <algorithm>
 #include "OutOfPhase.h"
 
 #include "PluginProcessor.h"
@@ -10,14 +11,50 @@
 OutOfPhaseAudio::OutOfPhaseAudio(OutOfPhaseAudioProcessor* processor)
 :WOLA(), m_processor(processor)
 {
+    m_job.owner = this;
 }
 
-void OutOfPhaseAudio::prepareToPlay(double sampleRate, int max_samplesPerBlock, int max_channels)
+OutOfPhaseAudio::~OutOfPhaseAudio()
+{
+    // frame jobs on the shared pool refer to this instance
+    completeFrame();
+    // late runs of the frame job find nothing to claim, but still refer to this instance
+    while (m_job.pendingRuns.load(std::memory_order_acquire) > 0)
+        juce::Thread::sleep(1);
+}
+
+void OutOfPhaseAudio::prepareToPlay(double sampleRate, int max_samplesPerBlock, const juce::AudioChannelSet& layout)
 {
-    juce::ScopedLock lock(dataMutex);
     juce::ignoreUnused(max_samplesPerBlock);
 
     updateFrequencyRange(sampleRate);
+    // the channel groups and the engine are handed to the audio thread as one configuration
+    ConfigEpoch::ScopedWrite reconfiguration(m_configEpoch);
+    m_channelGroups.setLayout(layout);
+    rebuildEngine(sampleRate, layout.size());
+    // a render starts without the memory of earlier playback (e.g. two bounces of the same part)
+    resetFrameProcessing();
+}
+
+void OutOfPhaseAudio::requestRebuild(int max_channels)
+{
+    // message thread: the pool threads run with realtime priority and the host expects
+    // latency changes from the message thread
+    JUCE_ASSERT_MESSAGE_THREAD
+    rebuildEngine(0.0, max_channels); // same sampling rate
+    m_processor->setLatencySamples(getLatency());
+}
+
+void OutOfPhaseAudio::rebuildEngine(double sampleRate, int max_channels)
+{
+    // the audio thread never waits: it skips the callbacks during the reconfiguration and
+    // sees the complete new configuration in the next one
+    ConfigEpoch::ScopedWrite reconfiguration(m_configEpoch);
+    // a frame may still be in work on a pool thread
+    completeFrame();
+
+    if (sampleRate > 0)
+        m_fs = sampleRate;
 
     float desired_blocksize = *m_processor->m_parameterVTS->getRawParameterValue(g_paramBlocksize.ID);
     int synchronblocksize = static_cast<int>(round(desired_blocksize));
@@ -25,25 +62,146 @@ void OutOfPhaseAudio::prepareToPlay(double sampleRate, int max_samplesPerBlock,
     if (g_forcePowerOf2)
         synchronblocksize = juce::nextPowerOfTwo(synchronblocksize);
 
+    int scheduling = static_cast<int>(*m_processor->m_parameterVTS->getRawParameterValue(g_paramScheduling.ID));
+    bool lookahead = scheduling != kSchedulingInline;
+
     // only resize if necessary 
-    if (synchronblocksize != m_synchronblocksize) {
+    if (synchronblocksize != m_synchronblocksize || scheduling != m_scheduling
+        || max_channels != static_cast<int>(m_channelState.size())) {
         m_synchronblocksize = synchronblocksize;
+        m_scheduling = scheduling;
         
         prepareWOLAprocessing(max_channels, synchronblocksize, WOLA::WOLAType::SqrtHann_over50);
-        m_fftprocess.setFFTSize(synchronblocksize);
-        
+
+        m_channelState.resize(static_cast<size_t>(max_channels));
+        for (auto& channel : m_channelState)
+        {
+            channel.fft.setFFTSize(synchronblocksize);
+            channel.randomPhases.assign(static_cast<std::size_t>(synchronblocksize/2+1), 0.0f);
+        }
         
-        m_PrePhaseData = std::vector<float>(static_cast<std::size_t>(synchronblocksize/2+1), 0.0f);
-        m_PostPhaseData = std::vector<float>(static_cast<std::size_t>(synchronblocksize/2+1), 0.0f);
         initFrostPhaseData();
+        m_bandWeights = std::vector<float>(static_cast<std::size_t>(synchronblocksize/2+1), 1.0f);
+        m_binBand = std::vector<int8_t>(static_cast<std::size_t>(synchronblocksize/2+1), 0);
         
+        m_dryBuffer.setSize(max_channels, synchronblocksize);
         m_realdata.setSize(max_channels, synchronblocksize/2+1);
         m_imagdata.setSize(max_channels, synchronblocksize/2+1);
         m_realdata.clear();
         m_imagdata.clear();
+        m_dryWetRamp.assign(static_cast<size_t>(synchronblocksize), 1.0f);
+        // a frame reaches back at most one blocksize, its history fits into the timelines
+        int minSpacing = std::max(1, synchronblocksize/64);
+        for (int band = 0; band < g_maxNumberOfBands; ++band)
+        {
+            m_paramLowFreq[band].setMinSpacing(minSpacing);
+            m_paramHighFreq[band].setMinSpacing(minSpacing);
+            m_paramDepth[band].setMinSpacing(minSpacing);
+        }
+        m_paramDryWet.setMinSpacing(minSpacing);
+        m_linkedPhasorReal.setSize(max_channels, synchronblocksize/2+1);
+        m_linkedPhasorImag.setSize(max_channels, synchronblocksize/2+1);
+        m_leaderPhasorReal.setSize(max_channels, synchronblocksize/2+1);
+        m_leaderPhasorImag.setSize(max_channels, synchronblocksize/2+1);
+        m_unitChannels.resize(static_cast<size_t>(max_channels));
+        m_unitStart.resize(static_cast<size_t>(max_channels + 1));
+
+        for (auto& frame : m_amortizedFrame)
+        {
+            frame.setSize(max_channels, lookahead ? synchronblocksize : 0);
+            frame.clear();
+        }
+        m_amortizedSlot = 0;
+        clearJob();
     }
     
-    m_Latency = synchronblocksize;
+    m_silenceClosePower = juce::Decibels::decibelsToGain(g_silenceCloseThreshold_dB) * juce::Decibels::decibelsToGain(g_silenceCloseThreshold_dB);
+    m_silenceOpenPower = juce::Decibels::decibelsToGain(g_silenceOpenThreshold_dB) * juce::Decibels::decibelsToGain(g_silenceOpenThreshold_dB);
+    m_silent = false;
+    m_silentFrames = 0;
+
+    m_Latency = synchronblocksize + (lookahead ? synchronblocksize/2 : 0);
+    m_phaseAnalyzer.setLatency(m_Latency);
+
+    // the delay line is only reallocated if the number of channels or the sampling rate changes
+    if (max_channels != m_bypassChannels || m_fs != m_bypassSampleRate)
+    {
+        m_bypassChannels = max_channels;
+        m_bypassSampleRate = m_fs;
+        // sized for the largest latency: largest blocksize with lookahead (Spread, Worker)
+        int maxBlocksize = juce::nextPowerOfTwo(g_paramBlocksize.maxValue);
+        m_bypass.prepare(max_channels, g_bypassMaxChunkSize, maxBlocksize + maxBlocksize/2,
+            static_cast<int>(g_bypassFadeTime_ms * 0.001 * m_fs));
+    }
+    m_bypass.setLatency(m_Latency);
+    m_configChanged = true;
+}
+
+void OutOfPhaseAudio::processWithBypass(juce::AudioBuffer<float>& data, juce::MidiBuffer& midiMessages, bool forceBypass)
+{
+    bool bypassed = forceBypass;
+    if (m_paramBypass != nullptr && m_paramBypass->load() > 0.5f)
+        bypassed = true;
+    // DryWet = 0 is not a bypass: the engine ramps DryWet sample accurately, also to and from 0
+
+    // a reconfiguration (e.g. new blocksize from the GUI) is in progress: output silence, never wait
+    if (!m_configEpoch.tryEnter())
+    {
+        data.clear();
+        return;
+    }
+
+    int numSamples = data.getNumSamples();
+    if (numSamples <= g_bypassMaxChunkSize)
+    {
+        processChunk(data, midiMessages, bypassed);
+    }
+    else
+    {
+        // long host blocks: process in parts (the channel pointers are referenced, no copy)
+        for (int start = 0; start < numSamples; start += g_bypassMaxChunkSize)
+        {
+            int chunkSize = juce::jmin(g_bypassMaxChunkSize, numSamples - start);
+            juce::AudioBuffer<float> chunk(data.getArrayOfWritePointers(), data.getNumChannels(), start, chunkSize);
+            processChunk(chunk, midiMessages, bypassed);
+        }
+    }
+    m_configEpoch.exit();
+}
+
+void OutOfPhaseAudio::syncToHostPosition(int64_t position)
+{
+    // the internal count continues the last host position, anything else is a transport start or a jump
+    if (position == getTimelinePosition())
+        return;
+    setTimelinePosition(position);
+    m_timelineJumped = true;
+}
+
+void OutOfPhaseAudio::processChunk(juce::AudioBuffer<float>& data, juce::MidiBuffer& midiMessages, bool bypassed)
+{
+    // the value of this block, also while bypassed (the frames after a bypass still reach back)
+    recordAutomation(data.getNumSamples());
+
+    if (!m_bypass.processInput(data, bypassed))
+    {
+        // bypassed: the output is just the delayed input, the timeline runs on (processBlock is skipped)
+        m_bypass.processOutput(data);
+        setTimelinePosition(getTimelinePosition() + data.getNumSamples());
+        return;
+    }
+
+    // the engine restarts after a bypass or a jump on the timeline, its memory holds old signal parts
+    // (the reset also realigns the frames to the timeline)
+    if (m_bypass.needsReset() || m_timelineJumped)
+    {
+        m_timelineJumped = false;
+        resetFrameProcessing();
+    }
+
+    processBlock(data, midiMessages);
+    advanceAmortizedWork();
+    m_bypass.processOutput(data);
 }
 
 void OutOfPhaseAudio::addParameter(std::vector<std::unique_ptr<juce::RangedAudioParameter>> &paramVector)
@@ -91,11 +249,192 @@ void OutOfPhaseAudio::addParameter(std::vector<std::unique_ptr<juce::RangedAudio
         g_paramHighFreq.defaultValue
     ));
 
+    paramVector.push_back(std::make_unique<juce::AudioParameterInt>(g_paramSeed.ID,
+        g_paramSeed.name, g_paramSeed.minValue, g_paramSeed.maxValue, g_paramSeed.defaultValue
+    ));
+
+    paramVector.push_back(std::make_unique<juce::AudioParameterBool>(g_paramBypass.ID,
+        g_paramBypass.name, g_paramBypass.defaultValue
+    ));
+
+    paramVector.push_back(std::make_unique<juce::AudioParameterChoice>(g_paramScheduling.ID,
+        g_paramScheduling.name,
+        juce::StringArray {g_paramScheduling.mode1, g_paramScheduling.mode2, g_paramScheduling.mode3}, g_paramScheduling.defaultValue
+    ));
+
+    paramVector.push_back(std::make_unique<juce::AudioParameterChoice>(g_paramChannelLink.ID,
+        g_paramChannelLink.name,
+        juce::StringArray {g_paramChannelLink.mode1, g_paramChannelLink.mode2, g_paramChannelLink.mode3}, g_paramChannelLink.defaultValue
+    ));
+
+    paramVector.push_back(std::make_unique<juce::AudioParameterBool>(g_paramPreserveImage.ID,
+        g_paramPreserveImage.name, g_paramPreserveImage.defaultValue
+    ));
+
+    paramVector.push_back(std::make_unique<juce::AudioParameterBool>(g_paramMidSide.ID,
+        g_paramMidSide.name, g_paramMidSide.defaultValue
+    ));
+
+    for (int cc = 0; cc < 2; ++cc)
+    {
+        paramVector.push_back(std::make_unique<juce::AudioParameterChoice>(g_paramMidSideMode.ID[cc],
+            g_paramMidSideMode.name[cc],
+            juce::StringArray {g_paramMidSideMode.modeOff, g_paramMode.mode1, g_paramMode.mode2, g_paramMode.mode3, g_paramMode.mode4},
+            g_paramMidSideMode.defaultValue[cc]
+        ));
+
+        paramVector.push_back(std::make_unique<juce::AudioParameterFloat>(g_paramMidSideDepth.ID[cc],
+            g_paramMidSideDepth.name[cc], g_paramMidSideDepth.minValue, g_paramMidSideDepth.maxValue, g_paramMidSideDepth.defaultValue
+        ));
+    }
+
+    paramVector.push_back(std::make_unique<juce::AudioParameterInt>(g_paramNumBands.ID,
+        g_paramNumBands.name, g_paramNumBands.minValue, g_paramNumBands.maxValue, g_paramNumBands.defaultValue
+    ));
+
+    // band 1 uses the global mode, distribution and frequency parameters from above
+    for (int band = 0; band < g_maxNumberOfBands; ++band)
+    {
+        if (band > 0)
+        {
+            paramVector.push_back(std::make_unique<juce::AudioParameterChoice>(getBandParamID(g_paramMode.ID, band),
+                getBandParamName(g_paramMode.name, band),
+                juce::StringArray {g_paramMode.mode1, g_paramMode.mode2, g_paramMode.mode3 , g_paramMode.mode4}, g_paramMode.defaultValue
+            ));
+
+            paramVector.push_back(std::make_unique<juce::AudioParameterChoice>(getBandParamID(g_paramDistributionMode.ID, band),
+                getBandParamName(g_paramDistributionMode.name, band),
+                juce::StringArray {g_paramDistributionMode.mode1, g_paramDistributionMode.mode2}, g_paramDistributionMode.defaultValue
+            ));
+
+            paramVector.push_back(std::make_unique<juce::AudioParameterFloat>(
+                juce::String(getBandParamID(g_paramLowFreq.ID, band)),
+                juce::String(getBandParamName(g_paramLowFreq.name, band)), 
+                g_paramLowFreq.minValue, 
+                initialMaxFreq, 
+                g_paramLowFreq.bandDefaultValues[band]
+            ));
+
+            paramVector.push_back(std::make_unique<juce::AudioParameterFloat>(
+                juce::String(getBandParamID(g_paramHighFreq.ID, band)),
+                juce::String(getBandParamName(g_paramHighFreq.name, band)), 
+                g_paramHighFreq.minValue, 
+                initialMaxFreq, 
+                g_paramHighFreq.bandDefaultValues[band]
+            ));
+        }
+
+        paramVector.push_back(std::make_unique<juce::AudioParameterFloat>(getBandParamID(g_paramDepth.ID, band),
+            getBandParamName(g_paramDepth.name, band), g_paramDepth.minValue, g_paramDepth.maxValue, g_paramDepth.defaultValue
+        ));
+    }
 }
 
 void OutOfPhaseAudio::prepareParameter(std::unique_ptr<juce::AudioProcessorValueTreeState> &vts)
 {
-    juce::ignoreUnused(vts);
+    for (int band = 0; band < g_maxNumberOfBands; ++band)
+    {
+        m_paramMode[band].prepareParameter(vts->getRawParameterValue(getBandParamID(g_paramMode.ID, band)));
+        m_paramDistributionMode[band].prepareParameter(vts->getRawParameterValue(getBandParamID(g_paramDistributionMode.ID, band)));
+        m_paramLowFreq[band].prepareParameter(vts->getRawParameterValue(getBandParamID(g_paramLowFreq.ID, band)));
+        m_paramHighFreq[band].prepareParameter(vts->getRawParameterValue(getBandParamID(g_paramHighFreq.ID, band)));
+        m_paramDepth[band].prepareParameter(vts->getRawParameterValue(getBandParamID(g_paramDepth.ID, band)));
+    }
+    m_paramDryWet.prepareParameter(vts->getRawParameterValue(g_paramDryWet.ID));
+    m_paramBandMode.prepareParameter(vts->getRawParameterValue(g_paramBandMode.ID));
+    m_paramNumBands.prepareParameter(vts->getRawParameterValue(g_paramNumBands.ID));
+    m_paramSeed.prepareParameter(vts->getRawParameterValue(g_paramSeed.ID));
+    // every new instance gets its own seed (decorrelated tracks), a restored state or preset overwrites it
+    if (auto* seed = vts->getParameter(g_paramSeed.ID))
+        seed->setValueNotifyingHost(seed->convertTo0to1(
+            static_cast<float>(juce::Random::getSystemRandom().nextInt(g_paramSeed.maxValue + 1))));
+    m_paramChannelLink.prepareParameter(vts->getRawParameterValue(g_paramChannelLink.ID));
+    m_paramPreserveImage.prepareParameter(vts->getRawParameterValue(g_paramPreserveImage.ID));
+    m_paramMidSide.prepareParameter(vts->getRawParameterValue(g_paramMidSide.ID));
+    for (int cc = 0; cc < 2; ++cc)
+    {
+        m_paramMidSideMode[cc].prepareParameter(vts->getRawParameterValue(g_paramMidSideMode.ID[cc]));
+        m_paramMidSideDepth[cc].prepareParameter(vts->getRawParameterValue(g_paramMidSideDepth.ID[cc]));
+    }
+    m_paramBypass = vts->getRawParameterValue(g_paramBypass.ID);
+}
+
+void OutOfPhaseAudio::recordAutomation(int numSamples)
+{
+    int64_t position = getTimelinePosition();
+    for (int band = 0; band < g_maxNumberOfBands; ++band)
+    {
+        m_paramLowFreq[band].record(position, numSamples);
+        m_paramHighFreq[band].record(position, numSamples);
+        m_paramDepth[band].record(position, numSamples);
+    }
+    m_paramDryWet.record(position, numSamples);
+}
+
+void OutOfPhaseAudio::updateParameterSnapshot(int64_t frameCentre)
+{
+    float value;
+    m_params.bandChanged = m_configChanged;
+    m_params.seedChanged = m_configChanged;
+    m_configChanged = false;
+
+    for (int band = 0; band < g_maxNumberOfBands; ++band)
+    {
+        auto& bandParams = m_params.bands[band];
+        // mode and distribution are read per bin and frame, nothing is derived from them
+        if (m_paramMode[band].updateWithNotification(value))
+            bandParams.mode = static_cast<int>(value);
+        if (m_paramDistributionMode[band].updateWithNotification(value))
+            bandParams.distribution = static_cast<int>(value);
+        // automated values are interpolated to the centre of the frame, the band weights follow per frame
+        value = m_paramLowFreq[band].getValueAt(frameCentre);
+        if (value != bandParams.lowFreq)
+        {
+            bandParams.lowFreq = value;
+            m_params.bandChanged = true;
+        }
+        value = m_paramHighFreq[band].getValueAt(frameCentre);
+        if (value != bandParams.highFreq)
+        {
+            bandParams.highFreq = value;
+            m_params.bandChanged = true;
+        }
+        value = juce::jlimit(0.0f, 1.0f, m_paramDepth[band].getValueAt(frameCentre));
+        if (value != bandParams.depth)
+        {
+            bandParams.depth = value;
+            m_params.bandChanged = true;
+        }
+    }
+
+    if (m_paramBandMode.updateWithNotification(value))
+    {
+        m_params.bandMode = value > 0.5f;
+        m_params.bandChanged = true;
+    }
+    if (m_paramNumBands.updateWithNotification(value))
+    {
+        m_params.numBands = juce::jlimit(1, g_maxNumberOfBands, static_cast<int>(value));
+        m_params.bandChanged = true;
+    }
+    if (m_paramSeed.updateWithNotification(value))
+    {
+        m_params.seed = static_cast<int>(value);
+        m_params.seedChanged = true;
+    }
+    if (m_paramChannelLink.updateWithNotification(value))
+        m_params.channelLink = juce::jlimit(0, 2, static_cast<int>(value));
+    if (m_paramPreserveImage.updateWithNotification(value))
+        m_params.preserveImage = value > 0.5f;
+    if (m_paramMidSide.updateWithNotification(value))
+        m_params.midSide = value > 0.5f;
+    for (int cc = 0; cc < 2; ++cc)
+    {
+        if (m_paramMidSideMode[cc].updateWithNotification(value))
+            m_params.midSideMode[cc] = juce::jlimit(0, 4, static_cast<int>(value)) - 1;
+        if (m_paramMidSideDepth[cc].updateWithNotification(value))
+            m_params.midSideDepth[cc] = juce::jlimit(0.0f, 1.0f, value);
+    }
 }
 
 int OutOfPhaseAudio::processWOLA(juce::AudioBuffer<float> &data, juce::MidiBuffer &midiMessages)
@@ -105,183 +444,658 @@ int OutOfPhaseAudio::processWOLA(juce::AudioBuffer<float> &data, juce::MidiBuffe
     if (data.getNumSamples() == 0 || m_synchronblocksize == 0)
         return 0;
 
-    if (m_tempPrePhaseData.size() != static_cast<std::size_t>(m_synchronblocksize/2+1)) {
-        m_tempPrePhaseData.resize(static_cast<std::size_t>(m_synchronblocksize/2+1));
-        m_tempPostPhaseData.resize(static_cast<std::size_t>(m_synchronblocksize/2+1));
+    if (m_scheduling == kSchedulingInline)
+    {
+        beginFrame(data);
+        // large frames: pool threads take channels, the audio thread works along and waits at the barrier
+        if (m_job.numStages > 0 && getNumFrameRuns() > 0)
+            submitFrame(getNumFrameRuns(), juce::Time::getHighResolutionTicks());
+        completeFrame();
+        return 0;
     }
 
-    int operatingMode = static_cast<int>(*m_processor->m_parameterVTS->getRawParameterValue(g_paramMode.ID));
-    float dryWetMix = *m_processor->m_parameterVTS->getRawParameterValue(g_paramDryWet.ID);
-    dryWetMix = juce::jlimit(0.0f, 1.0f, dryWetMix);
+    // lookahead: the frame of the last hop is finished (normally already during the last hop by
+    // advanceAmortizedWork or the worker) and given out, this frame is processed during the next hop
+    completeFrame();
+    int numchns = juce::jmin(data.getNumChannels(), m_amortizedFrame[0].getNumChannels());
+    int numSamples = juce::jmin(data.getNumSamples(), m_amortizedFrame[0].getNumSamples());
+    int nextSlot = 1 - m_amortizedSlot;
+    for (int cc = 0; cc < numchns; cc++)
+    {
+        m_amortizedFrame[nextSlot].copyFrom(cc, 0, data, cc, 0, numSamples);
+        data.copyFrom(cc, 0, m_amortizedFrame[m_amortizedSlot], cc, 0, numSamples);
+    }
+    m_amortizedSlot = nextSlot;
+    beginFrame(m_amortizedFrame[nextSlot]);
 
-    bool bandModeActive = *m_processor->m_parameterVTS->getRawParameterValue(g_paramBandMode.ID) > 0.5f;
-    float lowFreq = *m_processor->m_parameterVTS->getRawParameterValue(g_paramLowFreq.ID);
-    float highFreq = *m_processor->m_parameterVTS->getRawParameterValue(g_paramHighFreq.ID);
-    
-    int lowBin = 0;
-    int highBin = m_synchronblocksize / 2;
-    double sampleRate = m_processor->getSampleRate();
-    
-    int transitionWidth = 3;
+    if (m_scheduling == kSchedulingWorker && m_job.numStages > 0)
+        submitFrame(getNumFrameRuns(),
+            juce::Time::getHighResolutionTicks() + juce::Time::secondsToHighResolutionTicks(m_synchronblocksize / (2.0 * m_fs)));
+    return 0;
+}
 
-    if (bandModeActive) {
-        lowBin = static_cast<int>(std::floor(lowFreq * m_synchronblocksize / sampleRate));
-        highBin = static_cast<int>(std::ceil(highFreq * m_synchronblocksize / sampleRate));
-        
-        lowBin = juce::jlimit(0, m_synchronblocksize / 2, lowBin);
-        highBin = juce::jlimit(0, m_synchronblocksize / 2, highBin);
+int OutOfPhaseAudio::getNumFrameRuns() const
+{
+    int numUnits = m_job.numUnits;
+    bool parallel = numUnits >= 2 && m_job.numChannels * m_synchronblocksize >= g_parallelMinFrameSamples;
+    int numThreads = m_pool->getNumThreads();
+
+    if (m_scheduling == kSchedulingWorker)
+        return parallel ? juce::jmin(numUnits, numThreads) : 1;
+    if (m_scheduling == kSchedulingInline && parallel)
+        return juce::jmin(numUnits - 1, numThreads); // one unit is left for the audio thread
+    return 0;
+}
+
+void OutOfPhaseAudio::submitFrame(int numRuns, juce::int64 deadlineTicks)
+{
+    // opens the units for claiming, all fields of the job are visible to a claiming thread
+    m_job.pooled = true;
+    m_job.claimState.store((static_cast<uint64_t>(m_job.generation) << 32) | (static_cast<uint64_t>(m_job.numUnits) << 16),
+        std::memory_order_release);
+
+    // if the queues are full, the audio thread does the rest in completeFrame
+    for (int run = 0; run < numRuns; run++)
+    {
+        m_job.pendingRuns.fetch_add(1, std::memory_order_relaxed);
+        if (!m_pool->submit(&m_job, WorkerPool::Priority::Realtime, deadlineTicks))
+        {
+            m_job.pendingRuns.fetch_sub(1, std::memory_order_relaxed);
+            break;
+        }
     }
+}
+
+void OutOfPhaseAudio::FrameJob::run()
+{
+    owner->processClaimedUnits();
+    // last access to the instance
+    pendingRuns.fetch_sub(1, std::memory_order_release);
+}
+
+void OutOfPhaseAudio::beginFrame(juce::AudioBuffer<float>& data)
+{
+    clearJob();
+    m_job.data = &data;
+
+    // the frame covers [blockEnd - blocksize, blockEnd) of the timeline
+    int hopsize = m_synchronblocksize/2;
+    int64_t blockEnd = getBlockEndPosition();
+    updateParameterSnapshot(blockEnd - hopsize);
+
+    if (m_params.bandChanged)
+        updateBandWeights();
+
+    // random phases are a pure function of seed, channel, frame and bin (reproducible renders)
+    m_job.frameIndex = blockEnd >= 0 ? blockEnd / hopsize : -((-blockEnd + hopsize - 1) / hopsize);
+    if (m_params.seedChanged)
+        for (auto& channel : m_channelState)
+            channel.random.setSeed(static_cast<uint64_t>(m_params.seed));
+
+    // silent frames are passed through without spectral processing, the overlap-add
+    // drains the tail of the last processed frames (the latency stays the same)
+    if (isSilentFrame(data))
+        return;
+
     int numchns = data.getNumChannels();
     int numSamples = data.getNumSamples();
 
-    if (m_realdata.getNumChannels() < numchns || m_imagdata.getNumChannels() < numchns) {
-        return 0;
+    if (m_realdata.getNumChannels() < numchns || m_imagdata.getNumChannels() < numchns
+        || m_dryBuffer.getNumChannels() < numchns || m_dryBuffer.getNumSamples() < numSamples
+        || static_cast<int>(m_channelState.size()) < numchns) {
+        return;
     }
 
-    juce::AudioBuffer<float> dryBuffer;
-    dryBuffer.setSize(numchns, numSamples, false, true, true);
+    // mid/side: only the spectra with a mode are processed, an untouched frame is passed through as it is
+    if (m_params.midSide && numchns == 2)
+    {
+        if (!isMidSideChannelActive(0) && !isMidSideChannelActive(1))
+            return;
+        encodeMidSide(data);
+        m_job.midSide = true;
+    }
 
+    // dry/wet is mixed in the domain of the frame (mid/side is linear)
     for (int cc = 0; cc < numchns; cc++)
-        dryBuffer.copyFrom(cc, 0, data, cc, 0, numSamples);
+        m_dryBuffer.copyFrom(cc, 0, data, cc, 0, numSamples);
 
-    for (int cc = 0 ; cc < numchns; cc++)
+    // per sample dry/wet on the timeline: the overlap-add of the frames gives exactly this mix
+    if (static_cast<int>(m_dryWetRamp.size()) >= numSamples)
+    {
+        m_job.dryWetRamp = !m_paramDryWet.fillRamp(m_dryWetRamp.data(), blockEnd - numSamples, numSamples);
+        m_job.dryWet = juce::jlimit(0.0f, 1.0f, m_dryWetRamp[0]);
+    }
+    else
+    {
+        m_job.dryWet = juce::jlimit(0.0f, 1.0f, m_paramDryWet.getValueAt(blockEnd - hopsize));
+    }
+
+    // the image of linked channels needs the spectra, even for a flip
+    bool linked = m_params.channelLink != kLinkOff && numchns > 1 && !m_job.midSide;
+    m_job.preserveImage = linked && m_params.preserveImage;
+
+    // flip of the whole spectrum is a circular time reversal of the frame, no FFT needed
+    m_job.timeDomainFlip = !m_params.bandMode && m_params.bands[0].mode == 3 && m_params.bands[0].depth >= 1.0f
+        && !m_job.preserveImage && !m_job.midSide;
+
+    // a requested frost capture is taken from the last channel of this frame into the inactive slot,
+    // this frame is still processed with the active one
+    m_job.frostSlot = m_frostActiveSlot.load(std::memory_order_acquire);
+    m_job.captureFrost = m_frostCaptureRequested.exchange(false, std::memory_order_acq_rel);
+
+    if (!m_job.timeDomainFlip && linked)
+        drawLinkedPhases(numchns);
+
+    buildUnits(numchns);
+    m_job.numChannels = numchns;
+    m_job.numStages = m_job.numUnits * kStagesPerChannel;
+}
+
+void OutOfPhaseAudio::buildUnits(int numchns)
+{
+    int numUnits = 0;
+    int pos = 0;
+    for (int cc = 0; cc < numchns; cc++)
+    {
+        if (m_job.preserveImage && getLinkLeader(cc) != cc)
+            continue;
+        if (m_job.midSide && !isMidSideChannelActive(cc))
+            continue;
+        // the leader comes first, its FFT stage captures the phase the other channels refer to
+        m_unitStart[static_cast<size_t>(numUnits++)] = pos;
+        m_unitChannels[static_cast<size_t>(pos++)] = cc;
+        if (m_job.preserveImage)
+            for (int member = cc + 1; member < numchns; member++)
+                if (getLinkLeader(member) == cc)
+                    m_unitChannels[static_cast<size_t>(pos++)] = member;
+    }
+    for (int unitPos = 0; unitPos < pos; unitPos++)
+        m_job.frostChannel = juce::jmax(m_job.frostChannel, m_unitChannels[static_cast<size_t>(unitPos)]);
+    m_unitStart[static_cast<size_t>(numUnits)] = pos;
+    m_job.numUnits = numUnits;
+}
+
+void OutOfPhaseAudio::clearJob()
+{
+    // closes the job for the pool (no unit left to claim) before its fields change
+    m_job.claimState.store(static_cast<uint64_t>(++m_job.generation) << 32, std::memory_order_release);
+    m_job.unitsDone.store(0, std::memory_order_relaxed);
+    m_job.pooled = false;
+    m_job.linkedRandom = false;
+    m_job.preserveImage = false;
+    m_job.midSide = false;
+    m_job.dryWetRamp = false;
+    m_job.frostChannel = 0;
+    m_job.numStages = 0;
+    m_job.nextStage = 0;
+    m_job.captureFrost = false;
+}
+
+void OutOfPhaseAudio::completeFrame()
+{
+    if (m_job.numStages == 0)
+        return;
+
+    if (m_job.pooled)
+    {
+        // take the units the pool did not start, then wait for the ones it is working on:
+        // spin first (the last units are usually almost done), then park until the last one signals
+        processClaimedUnits();
+        for (int spin = 0; m_job.unitsDone.load(std::memory_order_acquire) < m_job.numUnits; spin++)
+        {
+            if (spin >= g_parallelBarrierSpins)
+                m_job.unitsFinished.wait(1.0);
+        }
+        m_job.nextStage = m_job.numStages;
+        finishFrame();
+    }
+    else
+    {
+        runFrameStages(m_job.numStages);
+    }
+}
+
+void OutOfPhaseAudio::processClaimedUnits()
+{
+    // a late worker may see a closed or already newer job, it only works on units it could claim
+    uint64_t state = m_job.claimState.load(std::memory_order_acquire);
+    for (;;)
+    {
+        int numUnits = static_cast<int>((state >> 16) & 0xffff);
+        int unit = static_cast<int>(state & 0xffff);
+        if (unit >= numUnits)
+            return;
+        if (!m_job.claimState.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+            continue;
+
+        for (int stage = 0; stage < kStagesPerChannel; stage++)
+            runUnitStage(unit, stage);
+        if (m_job.unitsDone.fetch_add(1, std::memory_order_acq_rel) + 1 == numUnits)
+            m_job.unitsFinished.signal();
+        state = m_job.claimState.load(std::memory_order_acquire);
+    }
+}
+
+void OutOfPhaseAudio::finishFrame()
+{
+    if (m_job.midSide)
+    {
+        decodeMidSide(*m_job.data);
+        m_job.midSide = false;
+    }
+    if (m_job.captureFrost)
+    {
+        m_frostActiveSlot.store(1 - m_job.frostSlot, std::memory_order_release);
+        m_job.captureFrost = false;
+    }
+    m_job.numStages = 0;
+}
+
+void OutOfPhaseAudio::runFrameStages(int untilStage)
+{
+    untilStage = juce::jmin(untilStage, m_job.numStages);
+    for (; m_job.nextStage < untilStage; m_job.nextStage++)
+        runUnitStage(m_job.nextStage / kStagesPerChannel, m_job.nextStage % kStagesPerChannel);
+
+    if (m_job.numStages > 0 && m_job.nextStage == m_job.numStages)
+        finishFrame();
+}
+
+void OutOfPhaseAudio::runUnitStage(int unit, int stage)
+{
+    int end = m_unitStart[static_cast<size_t>(unit + 1)];
+    for (int pos = m_unitStart[static_cast<size_t>(unit)]; pos < end; pos++)
+        runStage(m_unitChannels[static_cast<size_t>(pos)], stage);
+}
+
+void OutOfPhaseAudio::runStage(int cc, int stage)
+{
+    auto& data = *m_job.data;
+    int numSamples = data.getNumSamples();
+    auto& channel = m_channelState[static_cast<size_t>(cc)];
+
+    auto dataPtr = data.getWritePointer(cc);
+    auto realPtr = m_realdata.getWritePointer(cc);
+    auto imagPtr = m_imagdata.getWritePointer(cc);
+
+    bool captureChannel = m_job.captureFrost && cc == m_job.frostChannel;
+
+    if (m_job.timeDomainFlip)
+    {
+        // one stage does all the work, the other stages of the channel are empty
+        if (stage == 0)
+        {
+            flipTimeDomain(channel.fft, dataPtr, realPtr, imagPtr, captureChannel, 1 - m_job.frostSlot);
+            if (m_job.dryWetRamp)
+                mixDryWet(dataPtr, m_dryBuffer.getReadPointer(cc), numSamples, m_dryWetRamp.data());
+            else
+                mixDryWet(dataPtr, m_dryBuffer.getReadPointer(cc), numSamples, m_job.dryWet);
+        }
+        return;
+    }
+
+    if (stage == 0)
     {
         // FFT 
-        auto dataPtr = data.getWritePointer(cc);
-        auto realPtr = m_realdata.getWritePointer(cc);
-        auto imagPtr = m_imagdata.getWritePointer(cc);
-        m_fftprocess.fft(dataPtr, realPtr, imagPtr);
+        channel.fft.fft(dataPtr, realPtr, imagPtr);
+        if (captureChannel)
+            captureFrostPhasors(realPtr, imagPtr, 1 - m_job.frostSlot);
+        if (m_job.preserveImage && getLinkLeader(cc) == cc)
+            captureLeaderPhasors(realPtr, imagPtr, cc);
+    }
+    else if (stage == 1)
+    {
+        processSpectrum(realPtr, imagPtr, cc, m_FrostPhasorReal[m_job.frostSlot].data(), m_FrostPhasorImag[m_job.frostSlot].data());
+    }
+    else
+    {
+        channel.fft.ifft(realPtr, imagPtr, dataPtr);
+        if (m_job.dryWetRamp)
+            mixDryWet(dataPtr, m_dryBuffer.getReadPointer(cc), numSamples, m_dryWetRamp.data());
+        else
+            mixDryWet(dataPtr, m_dryBuffer.getReadPointer(cc), numSamples, m_job.dryWet);
+    }
+}
 
-        for (int nn = 0; nn < m_synchronblocksize/2+1; nn++)
+void OutOfPhaseAudio::advanceAmortizedWork()
+{
+    if (m_scheduling != kSchedulingSpread || m_job.nextStage >= m_job.numStages)
+        return;
+
+    // the stages are spread evenly over the hop, everything is done before the next frame starts
+    int hopsize = m_synchronblocksize/2;
+    int64_t target = (static_cast<int64_t>(m_job.numStages) * getSamplesSinceLastBlock() + hopsize - 1) / hopsize;
+    runFrameStages(static_cast<int>(target));
+}
+
+void OutOfPhaseAudio::resetFrameProcessing()
+{
+    // the pool may still write into the frame buffers
+    completeFrame();
+    resetWOLAprocessing();
+    for (auto& frame : m_amortizedFrame)
+        frame.clear();
+    m_amortizedSlot = 0;
+    clearJob();
+    m_silent = false;
+    m_silentFrames = 0;
+}
+
+int OutOfPhaseAudio::getLinkLeader(int channel) const
+{
+    if (m_params.channelLink == kLinkAll)
+        return 0;
+    if (m_params.channelLink == kLinkGroups)
+        return m_channelGroups.getLeader(channel);
+    return channel;
+}
+
+bool OutOfPhaseAudio::isMidSideChannelActive(int channel) const
+{
+    return m_params.midSideMode[channel] >= 0 && m_params.midSideDepth[channel] > 0.0f && m_lastBandBin >= m_firstBandBin;
+}
+
+int OutOfPhaseAudio::getChannelMode(int channel, int band) const
+{
+    return m_job.midSide ? m_params.midSideMode[channel] : m_params.bands[band].mode;
+}
+
+void OutOfPhaseAudio::encodeMidSide(juce::AudioBuffer<float>& data)
+{
+    auto left = data.getWritePointer(0);
+    auto right = data.getWritePointer(1);
+    for (int nn = 0; nn < data.getNumSamples(); nn++)
+    {
+        float mid = 0.5f * (left[nn] + right[nn]);
+        float side = 0.5f * (left[nn] - right[nn]);
+        left[nn] = mid;
+        right[nn] = side;
+    }
+}
+
+void OutOfPhaseAudio::decodeMidSide(juce::AudioBuffer<float>& data)
+{
+    auto mid = data.getWritePointer(0);
+    auto side = data.getWritePointer(1);
+    for (int nn = 0; nn < data.getNumSamples(); nn++)
+    {
+        float left = mid[nn] + side[nn];
+        float right = mid[nn] - side[nn];
+        mid[nn] = left;
+        side[nn] = right;
+    }
+}
+
+void OutOfPhaseAudio::drawRandomPhases(int channel)
+{
+    auto& state = m_channelState[static_cast<size_t>(channel)];
+
+    // random phases are only drawn for the bins of the bands in random mode
+    for (int band = 0; band < g_maxNumberOfBands; ++band)
+    {
+        const auto& bandParams = m_params.bands[band];
+        if (getChannelMode(channel, band) != 2 || m_bandLastBin[band] < m_bandFirstBin[band])
+            continue;
+        int numBins = m_bandLastBin[band] - m_bandFirstBin[band] + 1;
+        if (bandParams.distribution == 0) // Uniform
+            state.random.fillUniform(state.randomPhases.data(), m_bandFirstBin[band], numBins, static_cast<uint32_t>(channel), m_job.frameIndex);
+        else // Gaussian
+            state.random.fillGaussian(state.randomPhases.data(), m_bandFirstBin[band], numBins, static_cast<uint32_t>(channel), m_job.frameIndex, 0.5f);
+    }
+}
+
+void OutOfPhaseAudio::drawLinkedPhases(int numchns)
+{
+    bool anyRandom = false;
+    for (int band = 0; band < g_maxNumberOfBands; ++band)
+        if (m_params.bands[band].mode == 2 && m_bandLastBin[band] >= m_bandFirstBin[band])
+            anyRandom = true;
+    if (!anyRandom || m_linkedPhasorReal.getNumChannels() < numchns)
+        return;
+
+    // the field of a leader is the one it would draw unlinked, so linking does not change the leader itself
+    for (int cc = 0; cc < numchns; cc++)
+    {
+        if (getLinkLeader(cc) != cc)
+            continue;
+        drawRandomPhases(cc);
+        const float* randomPhases = m_channelState[static_cast<size_t>(cc)].randomPhases.data();
+        float* phasorReal = m_linkedPhasorReal.getWritePointer(cc);
+        float* phasorImag = m_linkedPhasorImag.getWritePointer(cc);
+        for (int band = 0; band < g_maxNumberOfBands; ++band)
         {
-            float absval = sqrtf(realPtr[nn]*realPtr[nn] + imagPtr[nn]*imagPtr[nn]);
-            float PrePhase = atan2f(imagPtr[nn], realPtr[nn]);
-            float PostPhase = atan2f(imagPtr[nn], realPtr[nn]);
-            
-            // effect weighting that creates smooth transitions
-            // between the band and the rest of the spectrum
-            float effectWeight = 1.0f;
-            
-            if (bandModeActive) {
-                effectWeight = 0.0f;
-                
-                if (nn >= lowBin && nn <= highBin) {
-                    effectWeight = 1.0f;
-                }
-                
-                if (nn < lowBin + transitionWidth && nn >= lowBin - transitionWidth) {
-
-                    effectWeight = juce::jmap<float>(static_cast<float>(nn), 
-                                                    static_cast<float>(lowBin - transitionWidth), 
-                                                    static_cast<float>(lowBin + transitionWidth), 
-                                                    0.0f, 1.0f);
-                    effectWeight = juce::jlimit(0.0f, 1.0f, effectWeight);
-                }
-                else if (nn > highBin - transitionWidth && nn <= highBin + transitionWidth) {
-
-                    effectWeight = juce::jmap<float>(static_cast<float>(nn), 
-                                                    static_cast<float>(highBin - transitionWidth), 
-                                                    static_cast<float>(highBin + transitionWidth), 
-                                                    1.0f, 0.0f);
-                    effectWeight = juce::jlimit(0.0f, 1.0f, effectWeight);
-                }
+            if (m_params.bands[band].mode != 2)
+                continue;
+            for (int nn = m_bandFirstBin[band]; nn <= m_bandLastBin[band]; nn++)
+            {
+                phasorReal[nn] = cosf(randomPhases[nn]);
+                phasorImag[nn] = sinf(randomPhases[nn]);
             }
+        }
+    }
+    m_job.linkedRandom = true;
+}
 
-            float originalPhase = PostPhase;
-            float processedPhase = PostPhase;
-            
-            // phase processing based on operating mode
-            if (operatingMode == 0)
+void OutOfPhaseAudio::processSpectrum(float* realPtr, float* imagPtr, int channel, const float* frostReal, const float* frostImag)
+{
+    const float* randomPhases = m_channelState[static_cast<size_t>(channel)].randomPhases.data();
+    const float* linkedReal = nullptr;
+    const float* linkedImag = nullptr;
+    if (m_job.linkedRandom)
+    {
+        // drawn once per hop and leader by drawLinkedPhases, no RNG and no trigonometry per channel
+        int leader = getLinkLeader(channel);
+        linkedReal = m_linkedPhasorReal.getReadPointer(leader);
+        linkedImag = m_linkedPhasorImag.getReadPointer(leader);
+    }
+    else
+    {
+        drawRandomPhases(channel);
+    }
+    const float* leaderReal = nullptr;
+    const float* leaderImag = nullptr;
+    if (m_job.preserveImage)
+    {
+        // captured by the FFT stage of the leader, which runs first in the unit
+        int leader = getLinkLeader(channel);
+        leaderReal = m_leaderPhasorReal.getReadPointer(leader);
+        leaderImag = m_leaderPhasorImag.getReadPointer(leader);
+    }
+    float depthScale = m_job.midSide ? m_params.midSideDepth[channel] : 1.0f;
+
+    // one pass over the spectrum, the bin->band table selects the mode,
+    // bins with zero weight are not touched at all (bit-exact to the input)
+    for (int nn = m_firstBandBin; nn <= m_lastBandBin; nn++)
+    {
+        // effect weighting that creates smooth transitions
+        // between the band and the rest of the spectrum
+        float effectWeight = m_bandWeights[static_cast<size_t>(nn)] * depthScale;
+        if (effectWeight <= 0.0f)
+            continue;
+        int operatingMode = getChannelMode(channel, m_binBand[static_cast<size_t>(nn)]);
+
+        const float inReal = realPtr[nn];
+        const float inImag = imagPtr[nn];
+        float absval = sqrtf(inReal*inReal + inImag*inImag);
+
+        // processed bin: same magnitude, new phase, the new phase is applied to the base |X|
+        // preserve image: base = X * conj(leader phasor), so the phase offset to the leader is kept
+        // (for the leader itself this is |X| again)
+        float baseReal = absval;
+        float baseImag = 0.0f;
+        if (leaderReal != nullptr)
+        {
+            baseReal = inReal * leaderReal[nn] + inImag * leaderImag[nn];
+            baseImag = inImag * leaderReal[nn] - inReal * leaderImag[nn];
+        }
+
+        float procReal = baseReal;
+        float procImag = baseImag;
+        if (operatingMode == 1) // frost
+        {
+            procReal = baseReal * frostReal[nn] - baseImag * frostImag[nn];
+            procImag = baseReal * frostImag[nn] + baseImag * frostReal[nn];
+        }
+        else if (operatingMode == 2) // random
+        {
+            float phasorReal, phasorImag;
+            if (linkedReal != nullptr)
             {
-                processedPhase = 0;
+                phasorReal = linkedReal[nn];
+                phasorImag = linkedImag[nn];
             }
-            else if (operatingMode == 1) // frost
+            else
             {
-                if (static_cast<size_t>(nn) < m_FrostPhaseData.size())
-                {
-                    processedPhase = m_FrostPhaseData[static_cast<size_t>(nn)];
-                }
-                else
-                {
-                    processedPhase = 0.0f;
-                }
+                float randomPhase = randomPhases[nn];
+                phasorReal = cosf(randomPhase);
+                phasorImag = sinf(randomPhase);
             }
-            else if (operatingMode == 2) // random
+            procReal = baseReal * phasorReal - baseImag * phasorImag;
+            procImag = baseReal * phasorImag + baseImag * phasorReal;
+        }
+        else if (operatingMode == 3) // flip = complex conjugate
+        {
+            if (leaderReal != nullptr)
             {
-                float DistributionModeID = *m_processor->m_parameterVTS->getRawParameterValue(g_paramDistributionMode.ID);
-                if (DistributionModeID == 0) // Uniform
-                {
-                    processedPhase = (juce::Random::getSystemRandom().nextFloat() * 2.0f - 1.0f) * juce::MathConstants<float>::pi;
-                }
-                else if (DistributionModeID == 1) // Gaussian
-                {
-                    static float nextGaussian = 0.0f;
-                    static bool hasNextGaussian = false;
-                    
-                    if (hasNextGaussian)
-                    {
-                        processedPhase = nextGaussian * juce::MathConstants<float>::pi;
-                        hasNextGaussian = false;
-                    }
-                    else
-                    {   // Box-Muller transform
-                        float u1, u2, s;
-                        do
-                        {
-                            u1 = juce::Random::getSystemRandom().nextFloat() * 2.0f - 1.0f;
-                            u2 = juce::Random::getSystemRandom().nextFloat() * 2.0f - 1.0f;
-                            s = u1 * u1 + u2 * u2;
-                        } while (s >= 1.0f || s == 0.0f);
-                        
-                        s = sqrtf(-2.0f * logf(s) / s);
-                        nextGaussian = u2 * s;
-                        float concentration = 0.5f;
-                        processedPhase = u1 * s * juce::MathConstants<float>::pi * concentration;
-                        hasNextGaussian = true;
-                    }
-
-                    processedPhase = juce::jlimit(-juce::MathConstants<float>::pi, juce::MathConstants<float>::pi, processedPhase);
-                }
+                // conjugate phase of the leader
+                procReal = baseReal * leaderReal[nn] + baseImag * leaderImag[nn];
+                procImag = baseImag * leaderReal[nn] - baseReal * leaderImag[nn];
             }
-            else if (operatingMode == 3) // flip
+            else
             {
-                processedPhase = -processedPhase;
+                procReal = inReal;
+                procImag = -inImag;
             }
-            
-            PostPhase = originalPhase * (1.0f - effectWeight) + processedPhase * effectWeight;
-            
-            realPtr[nn] = absval * cosf(PostPhase);
-            imagPtr[nn] = absval * sinf(PostPhase);
+        }
 
-            m_tempPrePhaseData[nn] = PrePhase;
-            m_tempPostPhaseData[nn] = PostPhase;
+        if (effectWeight >= 1.0f)
+        {
+            realPtr[nn] = procReal;
+            imagPtr[nn] = procImag;
         }
+        else
+        {
+            // nlerp of the phasors: blend linearly and restore the magnitude,
+            // this takes the short way around +-pi
+            float blendReal = inReal * (1.0f - effectWeight) + procReal * effectWeight;
+            float blendImag = inImag * (1.0f - effectWeight) + procImag * effectWeight;
+            float blendAbs = sqrtf(blendReal*blendReal + blendImag*blendImag);
+            if (blendAbs > 0.0f)
+            {
+                float gain = absval / blendAbs;
+                realPtr[nn] = blendReal * gain;
+                imagPtr[nn] = blendImag * gain;
+            }
+            else // opposite phasors, no preferred direction
+            {
+                realPtr[nn] = procReal;
+                imagPtr[nn] = procImag;
+            }
+        }
+    }
+}
 
-        m_fftprocess.ifft(realPtr, imagPtr, dataPtr);
+void OutOfPhaseAudio::flipTimeDomain(spectrum& fft, float* frame, float* realPtr, float* imagPtr, bool captureFrost, int frostSlot)
+{
+    // a frost capture still needs the input spectrum (one forward FFT, no inverse)
+    if (captureFrost)
+    {
+        fft.fft(frame, realPtr, imagPtr);
+        captureFrostPhasors(realPtr, imagPtr, frostSlot);
+    }
 
-        auto dryPtr = dryBuffer.getReadPointer(cc);
-        
-        float wetRatio = dryWetMix;
-        wetRatio = juce::jlimit(0.0f, 1.0f, wetRatio);
-        float dryRatio = 1.0f - wetRatio;
-        
-        for (int i = 0; i < numSamples; ++i)
-            dataPtr[i] = dryPtr[i] * dryRatio + dataPtr[i] * wetRatio;
+    // conj(X[k]) of a real frame x[n] is the spectrum of x[(N-n) mod N]
+    std::reverse(frame + 1, frame + m_synchronblocksize);
+}
+
+bool OutOfPhaseAudio::isSilentFrame(const juce::AudioBuffer<float>& data)
+{
+    int numchns = data.getNumChannels();
+    int numSamples = data.getNumSamples();
+    if (numchns == 0 || numSamples == 0)
+        return true;
+
+    float energy = 0.0f;
+    for (int cc = 0; cc < numchns; cc++)
+    {
+        auto dataPtr = data.getReadPointer(cc);
+        for (int nn = 0; nn < numSamples; nn++)
+            energy += dataPtr[nn] * dataPtr[nn];
     }
+    float meanPower = energy / static_cast<float>(numchns * numSamples);
 
+    // hysteresis: close after g_silenceHoldFrames quiet frames, open again above a higher threshold
+    if (m_silent)
     {
-        juce::ScopedLock lock(dataMutex);
-        std::swap(m_PrePhaseData, m_tempPrePhaseData);
-        std::swap(m_PostPhaseData, m_tempPostPhaseData);
+        if (meanPower > m_silenceOpenPower)
+        {
+            m_silent = false;
+            m_silentFrames = 0;
+        }
     }
+    else if (meanPower < m_silenceClosePower)
+    {
+        if (++m_silentFrames >= g_silenceHoldFrames)
+            m_silent = true;
+    }
+    else
+    {
+        m_silentFrames = 0;
+    }
+    return m_silent;
+}
 
+void OutOfPhaseAudio::captureFrostPhasors(const float* realPtr, const float* imagPtr, int slot)
+{
+    computeUnitPhasors(realPtr, imagPtr, m_FrostPhasorReal[slot].data(), m_FrostPhasorImag[slot].data(), m_synchronblocksize/2+1);
+}
 
-    return 0;
+void OutOfPhaseAudio::captureLeaderPhasors(const float* realPtr, const float* imagPtr, int leader)
+{
+    computeUnitPhasors(realPtr, imagPtr, m_leaderPhasorReal.getWritePointer(leader), m_leaderPhasorImag.getWritePointer(leader),
+        m_synchronblocksize/2+1);
 }
 
-OutOfPhaseGUI::~OutOfPhaseGUI()
+void OutOfPhaseAudio::computeUnitPhasors(const float* realPtr, const float* imagPtr, float* phasorReal, float* phasorImag, int numBins)
 {
+    for (int nn = 0; nn < numBins; nn++)
+    {
+        float absval = sqrtf(realPtr[nn]*realPtr[nn] + imagPtr[nn]*imagPtr[nn]);
+        if (absval > 0.0f)
+        {
+            phasorReal[nn] = realPtr[nn] / absval;
+            phasorImag[nn] = imagPtr[nn] / absval;
+        }
+        else
+        {
+            phasorReal[nn] = 1.0f;
+            phasorImag[nn] = 0.0f;
+        }
+    }
+}
+
+void OutOfPhaseAudio::mixDryWet(float* wet, const float* dry, int numSamples, float dryWetMix)
+{
+    float wetRatio = juce::jlimit(0.0f, 1.0f, dryWetMix);
+    float dryRatio = 1.0f - wetRatio;
+
+    for (int i = 0; i < numSamples; ++i)
+        wet[i] = dry[i] * dryRatio + wet[i] * wetRatio;
+}
+
+void OutOfPhaseAudio::mixDryWet(float* wet, const float* dry, int numSamples, const float* dryWetMix)
+{
+    for (int i = 0; i < numSamples; ++i)
+    {
+        float wetRatio = juce::jlimit(0.0f, 1.0f, dryWetMix[i]);
+        wet[i] = dry[i] * (1.0f - wetRatio) + wet[i] * wetRatio;
+    }
+}
 
+OutOfPhaseGUI::~OutOfPhaseGUI()
+{
+    if (m_isAnalysisConsumer)
+        m_processor.m_algo.getPhaseAnalyzer().removeConsumer();
 }
 
 OutOfPhaseGUI::OutOfPhaseGUI(OutOfPhaseAudioProcessor& p, juce::AudioProcessorValueTreeState& apvts)
@@ -299,19 +1113,50 @@ OutOfPhaseGUI::OutOfPhaseGUI(OutOfPhaseAudioProcessor& p, juce::AudioProcessorVa
     addAndMakeVisible(m_BlocksizeSlider);
     BlocksizeSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
         *m_processor.m_parameterVTS, g_paramBlocksize.ID, m_BlocksizeSlider);
-    m_BlocksizeSlider.onValueChange = [this]
-    {
-        juce::ScopedLock lock(m_processor.getCallbackLock());
-        m_processor.suspendProcessing(true);
-
-        auto sampleRate = m_processor.getSampleRate();
-        auto blockSize = m_BlocksizeSlider.getValue();
-        auto channels = m_processor.getTotalNumInputChannels();
 
-        m_processor.m_algo.prepareToPlay(sampleRate, static_cast<int>(blockSize), channels);
-
-        m_processor.suspendProcessing(false);
-    };
+    m_SchedulingBox.addItemList(juce::StringArray {g_paramScheduling.mode1, g_paramScheduling.mode2, g_paramScheduling.mode3}, 1);
+    m_SchedulingBox.setTooltip("FFT scheduling: Inline, Spread over the host buffers or on a Worker thread (both one hop more latency)");
+    addAndMakeVisible(m_SchedulingBox);
+    SchedulingBoxAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+        *m_processor.m_parameterVTS, g_paramScheduling.ID, m_SchedulingBox);
+
+    m_ChannelLinkBox.addItemList(juce::StringArray {g_paramChannelLink.mode1, g_paramChannelLink.mode2, g_paramChannelLink.mode3}, 1);
+    m_ChannelLinkBox.setTooltip("Channel link of the random phases: Off, per channel Group (L/R pairs, ambisonic orders) or All channels");
+    addAndMakeVisible(m_ChannelLinkBox);
+    ChannelLinkBoxAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+        *m_processor.m_parameterVTS, g_paramChannelLink.ID, m_ChannelLinkBox);
+    m_ChannelLinkBox.setEnabled(m_processor.getTotalNumInputChannels() > 1);
+
+    m_PreserveImageButton.setTooltip("Preserve image: linked channels keep their phase differences");
+    addAndMakeVisible(m_PreserveImageButton);
+    PreserveImageButtonAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        *m_processor.m_parameterVTS, g_paramPreserveImage.ID, m_PreserveImageButton);
+    m_PreserveImageButton.setEnabled(m_processor.getTotalNumInputChannels() > 1);
+
+    m_MidSideButton.setButtonText("M/S");
+    m_MidSideButton.setTooltip("Mid/Side: mid and side are processed with their own mode and depth");
+    addAndMakeVisible(m_MidSideButton);
+    MidSideButtonAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        *m_processor.m_parameterVTS, g_paramMidSide.ID, m_MidSideButton);
+    m_MidSideButton.setEnabled(m_processor.getTotalNumInputChannels() == 2);
+    for (int cc = 0; cc < 2; ++cc)
+    {
+        m_MidSideModeBox[cc].addItemList(juce::StringArray {g_paramMidSideMode.modeOff, g_paramMode.mode1, g_paramMode.mode2,
+            g_paramMode.mode3, g_paramMode.mode4}, 1);
+        m_MidSideModeBox[cc].setTooltip(juce::String(g_paramMidSideMode.name[cc]) + " (Off: passed through)");
+        addAndMakeVisible(m_MidSideModeBox[cc]);
+        MidSideModeBoxAttachment[cc] = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
+            *m_processor.m_parameterVTS, g_paramMidSideMode.ID[cc], m_MidSideModeBox[cc]);
+
+        m_MidSideDepthSlider[cc].setSliderStyle(juce::Slider::SliderStyle::LinearHorizontal);
+        m_MidSideDepthSlider[cc].setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+        m_MidSideDepthSlider[cc].setPopupDisplayEnabled(true, false, this);
+        m_MidSideDepthSlider[cc].setDoubleClickReturnValue(true, g_paramMidSideDepth.defaultValue);
+        m_MidSideDepthSlider[cc].setTooltip(g_paramMidSideDepth.name[cc]);
+        MidSideDepthSliderAttachment[cc] = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+            *m_processor.m_parameterVTS, g_paramMidSideDepth.ID[cc], m_MidSideDepthSlider[cc]);
+        addAndMakeVisible(m_MidSideDepthSlider[cc]);
+    }
 
     m_DryWetSlider.setNumDecimalPlacesToDisplay(2);
     m_DryWetSlider.setDoubleClickReturnValue(true, 0.5f);
@@ -322,11 +1167,43 @@ OutOfPhaseGUI::OutOfPhaseGUI(OutOfPhaseAudioProcessor& p, juce::AudioProcessorVa
     addAndMakeVisible(m_PrePhasePlot);
     addAndMakeVisible(m_PostPhasePlot);
 
+    // source of the phase plots, only this one is analysed by the audio thread
+    int numChannels = m_processor.getTotalNumInputChannels();
+    auto layout = m_processor.getChannelLayoutOfBus(true, 0);
+    for (int cc = 0; cc < numChannels; ++cc)
+    {
+        juce::String name = numChannels == 2 ? (cc == 0 ? "Left" : "Right") : "Ch " + juce::String(cc + 1);
+        // surround and ambisonic channels are named by the layout (e.g. Ls, ACN4)
+        if (numChannels > 2 && layout.size() == numChannels && !layout.isDiscreteLayout())
+            name = juce::AudioChannelSet::getAbbreviatedChannelTypeName(layout.getTypeOfChannel(cc));
+        m_AnalysisSourceBox.addItem(name, cc + 1);
+    }
+    if (numChannels >= 2)
+    {
+        m_AnalysisSourceBox.addItem("Mid", g_analysisSourceMidItem);
+        m_AnalysisSourceBox.addItem("Side", g_analysisSourceSideItem);
+    }
+    m_AnalysisSourceBox.setTooltip("Channel shown in the phase plots");
+    m_AnalysisSourceBox.onChange = [this] {
+        int itemId = m_AnalysisSourceBox.getSelectedId();
+        int source = PhaseAnalyzer::kSourceNone;
+        if (itemId == g_analysisSourceMidItem)
+            source = PhaseAnalyzer::kSourceMid;
+        else if (itemId == g_analysisSourceSideItem)
+            source = PhaseAnalyzer::kSourceSide;
+        else if (itemId > 0)
+            source = itemId - 1;
+        m_analysisSource = source;
+        m_processor.m_algo.getPhaseAnalyzer().setSource(source);
+    };
+    addAndMakeVisible(m_AnalysisSourceBox);
+    m_AnalysisSourceBox.setSelectedId(1, juce::sendNotificationSync);
+
     m_ZeroModeTextButton.setButtonText("Zero");
     addAndMakeVisible(m_ZeroModeTextButton);
     m_ZeroModeTextButton.onClick = [this]
     {
-        m_processor.m_parameterVTS->getParameterAsValue(g_paramMode.ID) = 0;
+        m_processor.m_parameterVTS->getParameterAsValue(getBandParamID(g_paramMode.ID, m_selectedBand)) = 0;
     };
     m_ZeroModeTextButton.setRadioGroupId(1);
     m_ZeroModeTextButton.setClickingTogglesState(true);
@@ -335,7 +1212,7 @@ OutOfPhaseGUI::OutOfPhaseGUI(OutOfPhaseAudioProcessor& p, juce::AudioProcessorVa
     addAndMakeVisible(m_FrostModeTextButton);
     m_FrostModeTextButton.onClick = [this]
     {
-        m_processor.m_parameterVTS->getParameterAsValue(g_paramMode.ID) = 1;
+        m_processor.m_parameterVTS->getParameterAsValue(getBandParamID(g_paramMode.ID, m_selectedBand)) = 1;
     };
     m_FrostModeTextButton.setRadioGroupId(1);
     m_FrostModeTextButton.setClickingTogglesState(true);
@@ -344,7 +1221,7 @@ OutOfPhaseGUI::OutOfPhaseGUI(OutOfPhaseAudioProcessor& p, juce::AudioProcessorVa
     addAndMakeVisible(m_RandomModeTextButton);
     m_RandomModeTextButton.onClick = [this]
     {
-        m_processor.m_parameterVTS->getParameterAsValue(g_paramMode.ID) = 2;
+        m_processor.m_parameterVTS->getParameterAsValue(getBandParamID(g_paramMode.ID, m_selectedBand)) = 2;
     };
     m_RandomModeTextButton.setRadioGroupId(1);
     m_RandomModeTextButton.setClickingTogglesState(true);
@@ -353,7 +1230,7 @@ OutOfPhaseGUI::OutOfPhaseGUI(OutOfPhaseAudioProcessor& p, juce::AudioProcessorVa
     addAndMakeVisible(m_FlipModeTextButton);
     m_FlipModeTextButton.onClick = [this]
     {
-        m_processor.m_parameterVTS->getParameterAsValue(g_paramMode.ID) = 3;
+        m_processor.m_parameterVTS->getParameterAsValue(getBandParamID(g_paramMode.ID, m_selectedBand)) = 3;
     };
     m_FlipModeTextButton.setRadioGroupId(1);
     m_FlipModeTextButton.setClickingTogglesState(true);
@@ -387,10 +1264,34 @@ OutOfPhaseGUI::OutOfPhaseGUI(OutOfPhaseAudioProcessor& p, juce::AudioProcessorVa
     };
     m_HighFreqKnob.setVisible(false);
 
+    // band selector, the knobs, depth and mode buttons always show the selected band
+    m_BandSelector.setMaxNumBands(g_maxNumberOfBands);
+    m_BandSelector.setNumBands(static_cast<int>(m_processor.m_parameterVTS->getRawParameterValue(g_paramNumBands.ID)->load()));
+    m_BandSelector.onNumBandsChanged = [this](int numBands) {
+        m_processor.m_parameterVTS->getParameterAsValue(g_paramNumBands.ID) = numBands;
+        m_BandSelector.setNumBands(numBands);
+        m_BandSelector.setSelectedBand(numBands - 1);
+    };
+    m_BandSelector.onBandSelected = [this](int band) {
+        selectBand(band);
+    };
+    addAndMakeVisible(m_BandSelector);
+    m_BandSelector.setVisible(false);
+
+    // depth of the selected band (of the whole spectrum without band mode)
+    m_DepthSlider.setSliderStyle(juce::Slider::SliderStyle::LinearHorizontal);
+    m_DepthSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    m_DepthSlider.setPopupDisplayEnabled(true, false, this);
+    m_DepthSlider.setDoubleClickReturnValue(true, g_paramDepth.defaultValue);
+    m_DepthSlider.setTooltip("Depth of the effect");
+    DepthSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        *m_processor.m_parameterVTS, g_paramDepth.ID, m_DepthSlider);
+    addAndMakeVisible(m_DepthSlider);
+
     addAndMakeVisible(m_DistributionSwitch);
     m_DistributionSwitch.setColour(juce::TextButton::buttonColourId, juce::Colours::transparentBlack);
     m_DistributionSwitch.onStateChange = [this]() {
-        m_processor.m_parameterVTS->getParameterAsValue(g_paramDistributionMode.ID) = 
+        m_processor.m_parameterVTS->getParameterAsValue(getBandParamID(g_paramDistributionMode.ID, m_selectedBand)) = 
             m_DistributionSwitch.getToggleState() ? 1 : 0;
     };
 
@@ -402,10 +1303,10 @@ OutOfPhaseGUI::OutOfPhaseGUI(OutOfPhaseAudioProcessor& p, juce::AudioProcessorVa
     addAndMakeVisible(m_FreezeCaptureButton);
     m_FreezeCaptureButton.setVisible(false);
 
-    float initialMode = m_processor.m_parameterVTS->getRawParameterValue(g_paramMode.ID)->load();
+    float initialMode = getSelectedBandValue(g_paramMode.ID);
     if (initialMode == 2.0f) {
         m_DistributionSwitch.setVisible(true);
-        bool isGaussian = m_processor.m_parameterVTS->getRawParameterValue(g_paramDistributionMode.ID)->load() == 1;
+        bool isGaussian = getSelectedBandValue(g_paramDistributionMode.ID) == 1;
         m_DistributionSwitch.setToggleState(isGaussian, juce::dontSendNotification);
     } else {
         m_DistributionSwitch.setVisible(false);
@@ -549,7 +1450,7 @@ void OutOfPhaseGUI::paint(juce::Graphics &g)
         juce::Justification::centred);
     
     if (m_DistributionSwitch.isVisible() && 
-        m_processor.m_parameterVTS->getRawParameterValue(g_paramMode.ID)->load() == 2.0f) {
+        getSelectedBandValue(g_paramMode.ID) == 2.0f) {
         g.drawText("Distribution", 
             m_DistributionSwitch.getX(),
             m_DistributionSwitch.getBottom() + static_cast<int>(5 * m_processor.getScaleFactor()),
@@ -613,11 +1514,29 @@ void OutOfPhaseGUI::resized() {
                                  .withTrimmedLeft(static_cast<int>(10 * scaleFactor))
                                  .withTrimmedRight(static_cast<int>(10 * scaleFactor)));
 
+    m_AnalysisSourceBox.setBounds(
+        m_PrePhasePlot.getRight() - static_cast<int>(70 * scaleFactor),
+        m_PrePhasePlot.getY() + static_cast<int>(6 * scaleFactor),
+        static_cast<int>(64 * scaleFactor),
+        static_cast<int>(18 * scaleFactor));
+
     r.removeFromTop(static_cast<int>(displayHeight * 0.05));
     m_PostPhasePlot.setBounds(r.removeFromTop(static_cast<int>(displayHeight * 0.23))
                                   .withTrimmedLeft(static_cast<int>(80 * scaleFactor))
                                   .withTrimmedRight(static_cast<int>(80 * scaleFactor)));
 
+    // mid/side controls in the margins of the post phase plot: toggle, mode and depth (mid left, side right)
+    int midSideWidth = m_PostPhasePlot.getX() - static_cast<int>(10 * scaleFactor);
+    int midSideRowHeight = static_cast<int>(18 * scaleFactor);
+    int midSideRowSpacing = static_cast<int>(20 * scaleFactor);
+    int midSideX[2] = {static_cast<int>(5 * scaleFactor), m_PostPhasePlot.getRight() + static_cast<int>(5 * scaleFactor)};
+    m_MidSideButton.setBounds(midSideX[0], m_PostPhasePlot.getY(), midSideWidth, midSideRowHeight);
+    for (int cc = 0; cc < 2; ++cc)
+    {
+        m_MidSideModeBox[cc].setBounds(midSideX[cc], m_PostPhasePlot.getY() + midSideRowSpacing, midSideWidth, midSideRowHeight);
+        m_MidSideDepthSlider[cc].setBounds(midSideX[cc], m_PostPhasePlot.getY() + 2 * midSideRowSpacing, midSideWidth, midSideRowHeight);
+    }
+
     float sliderHeight = static_cast<float>(knobHeight * 2.5);
     float sliderWidth = static_cast<float>(knobWidth * 0.4);
     
@@ -628,12 +1547,31 @@ void OutOfPhaseGUI::resized() {
         static_cast<int>(sliderWidth), 
         static_cast<int>(sliderHeight));
     
+    // above the blocksize label
+    m_SchedulingBox.setBounds(
+        m_BlocksizeSlider.getX() - static_cast<int>(10 * scaleFactor),
+        m_BlocksizeSlider.getY() - static_cast<int>(46 * scaleFactor),
+        static_cast<int>(80 * scaleFactor),
+        static_cast<int>(20 * scaleFactor));
+
     m_DryWetSlider.setBounds(
         static_cast<int>(getWidth() - sliderWidth - distance * 0.6), 
         static_cast<int>(distance * 4.2) + sliderVerticalOffset, 
         static_cast<int>(sliderWidth), 
         static_cast<int>(sliderHeight));
 
+    // above the drywet label, mirrors the scheduling box
+    m_ChannelLinkBox.setBounds(
+        m_DryWetSlider.getRight() + static_cast<int>(10 * scaleFactor) - m_SchedulingBox.getWidth(),
+        m_SchedulingBox.getY(),
+        m_SchedulingBox.getWidth(),
+        m_SchedulingBox.getHeight());
+    m_PreserveImageButton.setBounds(
+        m_ChannelLinkBox.getX() - m_ChannelLinkBox.getHeight(),
+        m_ChannelLinkBox.getY(),
+        m_ChannelLinkBox.getHeight(),
+        m_ChannelLinkBox.getHeight());
+
     float buttonsStartX = static_cast<float>(getWidth() / 2 - buttonWidth - buttonSpacing / 2);
     float buttonsStartY = static_cast<float>(getHeight() / 2 + distance / 2);
 
@@ -654,14 +1592,14 @@ void OutOfPhaseGUI::resized() {
     int switchY = m_RandomModeTextButton.getBottom() + static_cast<int>(25 * scaleFactor);
     m_DistributionSwitch.setBounds(switchX, switchY, switchWidth, switchHeight);
 
-    float currentMode = m_processor.m_parameterVTS->getRawParameterValue(g_paramMode.ID)->load();
+    float currentMode = getSelectedBandValue(g_paramMode.ID);
     bool randomMode = (currentMode == 2.0f);
     bool frostMode = (currentMode == 1.0f);
     
     if (m_DistributionSwitch.isVisible() != randomMode) {
         m_DistributionSwitch.setVisible(randomMode);
         if (randomMode) {
-            bool isGaussian = m_processor.m_parameterVTS->getRawParameterValue(g_paramDistributionMode.ID)->load() == 1;
+            bool isGaussian = getSelectedBandValue(g_paramDistributionMode.ID) == 1;
             m_DistributionSwitch.setToggleState(isGaussian, juce::dontSendNotification);
         }
     }
@@ -676,6 +1614,12 @@ void OutOfPhaseGUI::resized() {
     int bandY = getHeight() - bandButtonHeight - static_cast<int>(distance * 0.5f);
     int bandX = (getWidth() - bandButtonWidth) / 2;
     m_BandModeButton.setBounds(bandX, bandY, bandButtonWidth, bandButtonHeight);
+
+    int selectorHeight = static_cast<int>(bandButtonHeight * 0.7f);
+    m_BandSelector.setBounds(bandX, bandY - selectorHeight - static_cast<int>(4 * scaleFactor), bandButtonWidth, selectorHeight);
+
+    int depthHeight = static_cast<int>(distance * 0.4f);
+    m_DepthSlider.setBounds(bandX, m_BandModeButton.getBottom() + static_cast<int>(2 * scaleFactor), bandButtonWidth, depthHeight);
     
     if (m_LowFreqKnob.isVisible()) {
         int knobSize = static_cast<int>(knobWidth * 0.6f);
@@ -701,7 +1645,7 @@ void OutOfPhaseGUI::resized() {
 
 void OutOfPhaseGUI::updateModeButtonStates()
 {
-    float currentMode = m_processor.m_parameterVTS->getRawParameterValue(g_paramMode.ID)->load();
+    float currentMode = getSelectedBandValue(g_paramMode.ID);
     
     m_ZeroModeTextButton.setToggleState(currentMode == 0.0f, juce::dontSendNotification);
     m_FrostModeTextButton.setToggleState(currentMode == 1.0f, juce::dontSendNotification);
@@ -713,7 +1657,7 @@ void OutOfPhaseGUI::updateModeButtonStates()
         m_DistributionSwitch.setVisible(isRandomMode);
         
         if (isRandomMode) {
-            bool isGaussian = m_processor.m_parameterVTS->getRawParameterValue(g_paramDistributionMode.ID)->load() == 1;
+            bool isGaussian = getSelectedBandValue(g_paramDistributionMode.ID) == 1;
             m_DistributionSwitch.setToggleState(isGaussian, juce::dontSendNotification);
         }
     }
@@ -724,59 +1668,199 @@ void OutOfPhaseGUI::updateModeButtonStates()
     }
 
     bool bandModeActive = m_BandModeButton.getToggleState();
+    if (bandModeActive)
+        m_BandSelector.setNumBands(static_cast<int>(m_processor.m_parameterVTS->getRawParameterValue(g_paramNumBands.ID)->load()));
+    else
+        m_BandSelector.setSelectedBand(0);
+
     if (m_LowFreqKnob.isVisible() != bandModeActive) {
         m_LowFreqKnob.setVisible(bandModeActive);
         m_HighFreqKnob.setVisible(bandModeActive);
+        m_BandSelector.setVisible(bandModeActive);
         resized();
     }
 }
 
+float OutOfPhaseGUI::getSelectedBandValue(const std::string& baseID)
+{
+    return m_processor.m_parameterVTS->getRawParameterValue(getBandParamID(baseID, m_selectedBand))->load();
+}
+
+void OutOfPhaseGUI::selectBand(int band)
+{
+    if (band == m_selectedBand)
+        return;
+    m_selectedBand = band;
+
+    // the old attachments have to be gone before the new ones set the slider values
+    LowFreqKnobAttachment.reset();
+    HighFreqKnobAttachment.reset();
+    DepthSliderAttachment.reset();
+    LowFreqKnobAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        *m_processor.m_parameterVTS, getBandParamID(g_paramLowFreq.ID, band), m_LowFreqKnob);
+    HighFreqKnobAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        *m_processor.m_parameterVTS, getBandParamID(g_paramHighFreq.ID, band), m_HighFreqKnob);
+    DepthSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        *m_processor.m_parameterVTS, getBandParamID(g_paramDepth.ID, band), m_DepthSlider);
+
+    bool isGaussian = getSelectedBandValue(g_paramDistributionMode.ID) == 1;
+    m_DistributionSwitch.setToggleState(isGaussian, juce::dontSendNotification);
+
+    updateModeButtonStates();
+    resized();
+    repaint();
+}
+
+void OutOfPhaseAudio::updateBandWeights()
+{
+    const int transitionWidth = 3;
+    int nrOfBins = m_synchronblocksize/2+1;
+    if (static_cast<int>(m_bandWeights.size()) != nrOfBins)
+        return;
+
+    for (int band = 0; band < g_maxNumberOfBands; ++band)
+    {
+        m_bandFirstBin[band] = nrOfBins;
+        m_bandLastBin[band] = -1;
+    }
+
+    // without band mode, band 0 covers the whole spectrum
+    if (!m_params.bandMode)
+    {
+        float depth = m_params.bands[0].depth;
+        std::fill(m_bandWeights.begin(), m_bandWeights.end(), depth);
+        std::fill(m_binBand.begin(), m_binBand.end(), static_cast<int8_t>(0));
+        m_firstBandBin = 0;
+        m_lastBandBin = depth > 0.0f ? nrOfBins - 1 : -1;
+        m_bandFirstBin[0] = m_firstBandBin;
+        m_bandLastBin[0] = m_lastBandBin;
+        return;
+    }
+
+    std::fill(m_bandWeights.begin(), m_bandWeights.end(), 0.0f);
+    std::fill(m_binBand.begin(), m_binBand.end(), static_cast<int8_t>(0));
+
+    // where bands overlap, the band with the larger weight owns the bin
+    for (int band = 0; band < m_params.numBands; ++band)
+    {
+        const auto& bandParams = m_params.bands[band];
+        if (bandParams.depth <= 0.0f)
+            continue;
+
+        int lowBin = static_cast<int>(std::floor(bandParams.lowFreq * m_synchronblocksize / m_fs));
+        int highBin = static_cast<int>(std::ceil(bandParams.highFreq * m_synchronblocksize / m_fs));
+        lowBin = juce::jlimit(0, m_synchronblocksize / 2, lowBin);
+        highBin = juce::jlimit(0, m_synchronblocksize / 2, highBin);
+
+        // raised-cosine edges over [edge - transitionWidth, edge + transitionWidth]
+        int startBin = std::max(0, lowBin - transitionWidth + 1);
+        int endBin = std::min(nrOfBins - 1, highBin + transitionWidth - 1);
+        for (int nn = startBin; nn <= endBin; nn++)
+        {
+            float lowWeight = 1.0f;
+            if (nn < lowBin + transitionWidth)
+                lowWeight = 0.5f - 0.5f * cosf(juce::MathConstants<float>::pi * (nn - lowBin + transitionWidth) / (2.0f * transitionWidth));
+
+            float highWeight = 1.0f;
+            if (nn > highBin - transitionWidth)
+                highWeight = 0.5f + 0.5f * cosf(juce::MathConstants<float>::pi * (nn - highBin + transitionWidth) / (2.0f * transitionWidth));
+
+            float weight = std::min(lowWeight, highWeight) * bandParams.depth;
+            if (weight > m_bandWeights[static_cast<size_t>(nn)])
+            {
+                m_bandWeights[static_cast<size_t>(nn)] = weight;
+                m_binBand[static_cast<size_t>(nn)] = static_cast<int8_t>(band);
+            }
+        }
+    }
+
+    m_firstBandBin = nrOfBins;
+    m_lastBandBin = -1;
+    for (int nn = 0; nn < nrOfBins; nn++)
+    {
+        if (m_bandWeights[static_cast<size_t>(nn)] > 0.0f)
+        {
+            int band = m_binBand[static_cast<size_t>(nn)];
+            m_firstBandBin = std::min(m_firstBandBin, nn);
+            m_lastBandBin = nn;
+            m_bandFirstBin[band] = std::min(m_bandFirstBin[band], nn);
+            m_bandLastBin[band] = nn;
+        }
+    }
+}
+
 void OutOfPhaseAudio::updateFrequencyRange(double sampleRate)
 {
     if (sampleRate > 0)
     {
         float nyquistFreq = static_cast<float>(sampleRate / 2.0);
         
-        if (auto* lowFreqParam = dynamic_cast<juce::AudioParameterFloat*>(
-                m_processor->m_parameterVTS->getParameter(g_paramLowFreq.ID)))
+        for (int band = 0; band < g_maxNumberOfBands; ++band)
         {
-            lowFreqParam->range.end = nyquistFreq;
-            
-            float currentValue = *m_processor->m_parameterVTS->getRawParameterValue(g_paramLowFreq.ID);
-            if (currentValue > nyquistFreq)
-                *m_processor->m_parameterVTS->getRawParameterValue(g_paramLowFreq.ID) = nyquistFreq;
-        }
-        
-        if (auto* highFreqParam = dynamic_cast<juce::AudioParameterFloat*>(
-                m_processor->m_parameterVTS->getParameter(g_paramHighFreq.ID)))
-        {
-            highFreqParam->range.end = nyquistFreq;
+            const std::string lowFreqID = getBandParamID(g_paramLowFreq.ID, band);
+            const std::string highFreqID = getBandParamID(g_paramHighFreq.ID, band);
+
+            if (auto* lowFreqParam = dynamic_cast<juce::AudioParameterFloat*>(
+                    m_processor->m_parameterVTS->getParameter(lowFreqID)))
+            {
+                lowFreqParam->range.end = nyquistFreq;
+                
+                float currentValue = *m_processor->m_parameterVTS->getRawParameterValue(lowFreqID);
+                if (currentValue > nyquistFreq)
+                    *m_processor->m_parameterVTS->getRawParameterValue(lowFreqID) = nyquistFreq;
+            }
             
-            float currentValue = *m_processor->m_parameterVTS->getRawParameterValue(g_paramHighFreq.ID);
-            if (currentValue > nyquistFreq)
-                *m_processor->m_parameterVTS->getRawParameterValue(g_paramHighFreq.ID) = nyquistFreq;
+            if (auto* highFreqParam = dynamic_cast<juce::AudioParameterFloat*>(
+                    m_processor->m_parameterVTS->getParameter(highFreqID)))
+            {
+                highFreqParam->range.end = nyquistFreq;
+                
+                float currentValue = *m_processor->m_parameterVTS->getRawParameterValue(highFreqID);
+                if (currentValue > nyquistFreq)
+                    *m_processor->m_parameterVTS->getRawParameterValue(highFreqID) = nyquistFreq;
+            }
         }
     }
 }
 
 void OutOfPhaseGUI::timerCallback()
 {
-    std::vector<float> prePhaseDataCopy;
-    std::vector<float> postPhaseDataCopy;
-    
-    prePhaseDataCopy = m_processor.m_algo.getPrePhaseData();
-    postPhaseDataCopy = m_processor.m_algo.getPostPhaseData();
-    
-    m_PrePhasePlot.setPrePhaseData(std::move(prePhaseDataCopy));
-    m_PostPhasePlot.setPostPhaseData(std::move(postPhaseDataCopy));
+    // reads the latest frame in place, the plots keep their own copy (no allocation after the first frame)
+    // frames of a previously selected source are skipped
+    if (m_processor.m_algo.getPhaseAnalyzer().update() &&
+        m_processor.m_algo.getPhaseAnalyzer().getFrame().source == m_analysisSource)
+    {
+        const auto& frame = m_processor.m_algo.getPhaseAnalyzer().getFrame();
+        m_PrePhasePlot.setPrePhaseData(frame.preMin, frame.preMax, LogDisplayDecimator::kNumColumns);
+        m_PostPhasePlot.setPostPhaseData(frame.postMin, frame.postMax, LogDisplayDecimator::kNumColumns);
+    }
     
     updateModeButtonStates();
     
     repaint();
 }
 
+void OutOfPhaseGUI::visibilityChanged()
+{
+    updateAnalysisConsumer();
+}
+
+void OutOfPhaseGUI::updateAnalysisConsumer()
+{
+    bool showing = isShowing();
+    if (showing == m_isAnalysisConsumer)
+        return;
+
+    m_isAnalysisConsumer = showing;
+    if (showing)
+        m_processor.m_algo.getPhaseAnalyzer().addConsumer();
+    else
+        m_processor.m_algo.getPhaseAnalyzer().removeConsumer();
+}
+
 void OutOfPhaseGUI::parentHierarchyChanged()
 {
+    updateAnalysisConsumer();
     updateModeButtonStates();
     resized();
 }
\ No newline at end of file
@@ -1,9 +1,18 @@
 #pragma once
 
 #include <vector>
+#include <atomic>
 #include <juce_audio_processors/juce_audio_processors.h>
 
 #include "tools/SynchronBlockProcessor.h"
+#include "tools/PhaseRandom.h"
+#include "tools/AudioProcessParameter.h"
+#include "tools/PhaseAnalyzer.h"
+#include "tools/LatencyBypass.h"
+#include "tools/ConfigEpoch.h"
+#include "tools/WorkerPool.h"
+#include "tools/ChannelGroups.h"
+#include "tools/ParameterTimeline.h"
 #include "PluginSettings.h"
 #include "libs/FFT.h"
 
@@ -17,6 +26,7 @@
 #include "customComponents/FreezeCaptureButton.h"
 #include "customComponents/BandModeButton.h"
 #include "customComponents/FrequencyKnob.h"
+#include "customComponents/BandSelector.h"
 
 class OutOfPhaseAudioProcessor;
 
@@ -59,6 +69,21 @@ const struct
 	const float maxValue = 1;
 }g_paramDryWet;
 
+// band mode: up to g_maxNumberOfBands bands, each with its own frequency range, mode, distribution and depth
+// band 1 keeps the IDs of the single band version (mode and distribution are the global ones),
+// bands 2 ... 8 append their number to the ID, e.g. "lowfreq2" or "ModeID2"
+const int g_maxNumberOfBands = 8;
+
+inline std::string getBandParamID(const std::string& baseID, int band)
+{
+	return band == 0 ? baseID : baseID + std::to_string(band + 1);
+}
+
+inline std::string getBandParamName(const std::string& baseName, int band)
+{
+	return band == 0 ? baseName : "Band " + std::to_string(band + 1) + " " + baseName;
+}
+
 const struct
 {
     const std::string ID = "bandmode";
@@ -73,6 +98,7 @@ const struct
     const float minValue = 20.0f;
     // maxValue will be set dynamically based on sample rate
     const float defaultValue = 100.0f;
+    const float bandDefaultValues[g_maxNumberOfBands] = {100.0f, 20.0f, 80.0f, 250.0f, 800.0f, 2500.0f, 6000.0f, 12000.0f};
 } g_paramLowFreq;
 
 const struct
@@ -82,15 +108,147 @@ const struct
     const float minValue = 20.0f;
     // maxValue will be set dynamically based on sample rate
     const float defaultValue = 5000.0f;
+    const float bandDefaultValues[g_maxNumberOfBands] = {5000.0f, 80.0f, 250.0f, 800.0f, 2500.0f, 6000.0f, 12000.0f, 20000.0f};
 } g_paramHighFreq;
 
+const struct
+{
+	const std::string ID = "numbands";
+	const std::string name = "Number of Bands";
+	const int defaultValue = 1;
+	const int minValue = 1;
+	const int maxValue = g_maxNumberOfBands;
+}g_paramNumBands;
+
+// amount of the effect within a band (1 = fully processed)
+const struct
+{
+	const std::string ID = "DepthID";
+	const std::string name = "Depth";
+	const float defaultValue = 1;
+	const float minValue = 0;
+	const float maxValue = 1;
+}g_paramDepth;
+
+// seed of the random phase generator, the same seed gives bit-identical renders
+// (a new instance draws a random seed, it is saved with the state)
+const struct
+{
+	const std::string ID = "SeedID";
+	const std::string name = "Random Seed";
+	const int defaultValue = 0;
+	const int minValue = 0;
+	const int maxValue = 65535;
+}g_paramSeed;
+
+// soft bypass: the input is delayed by the latency, the WOLA engine does not run while bypassed,
+// transitions are crossfaded
+const struct
+{
+	const std::string ID = "BypassID";
+	const std::string name = "Bypass";
+	const bool defaultValue = false;
+}g_paramBypass;
+const float g_bypassFadeTime_ms = 20.0f;
+// blocks longer than this are processed in parts (bounds the delay line of the bypass)
+const int g_bypassMaxChunkSize = 4096;
+
+// scheduling of the spectral work of a frame
+// Inline: everything in the synchron block of the host callback (no extra latency)
+// Spread: FFT, spectral kernel and iFFT are spread evenly over the host callbacks of the next hop
+// (flat CPU load for small host buffers), costs one hop of latency
+// Worker: the frame is processed by a realtime worker thread during the next hop, costs one hop of latency
+const struct
+{
+	const std::string ID = "SchedulingID";
+	const std::string name = "FFT Scheduling";
+	const std::string mode1 = "Inline";
+	const std::string mode2 = "Spread";
+	const std::string mode3 = "Worker";
+	const int defaultValue = 0;
+}g_paramScheduling;
+// Inline and Worker: the channels of a frame are processed in parallel on the shared worker pool if there are
+// at least two and channels * blocksize reaches g_parallelMinFrameSamples (below, waking up the pool costs more than it saves)
+const int g_parallelMinFrameSamples = 16384;
+// barrier before the overlap-add: the audio thread spins this often, then parks until the last channel is done
+const int g_parallelBarrierSpins = 2000;
+
+// largest supported bus layout (in and output are the same), e.g. 7.1.4 (12) or third order ambisonics (16)
+const int g_maxNumberOfChannels = 16;
+
+// random phases of linked channels come from one phase field (drawn once per hop and group):
+// Off: every channel has its own, Groups: one per channel group of the layout (L/R pairs, ambisonic orders, ...),
+// All: one for all channels
+const struct
+{
+	const std::string ID = "ChannelLinkID";
+	const std::string name = "Channel Link";
+	const std::string mode1 = "Off";
+	const std::string mode2 = "Groups";
+	const std::string mode3 = "All";
+	const int defaultValue = 0;
+}g_paramChannelLink;
+
+// linked channels keep the phase differences of the input: the processed phase (zero, frost, random or flip)
+// is applied to the group leader, the other channels keep their phase offset to it
+const struct
+{
+	const std::string ID = "PreserveImageID";
+	const std::string name = "Preserve Image";
+	const bool defaultValue = false;
+}g_paramPreserveImage;
+
+// mid/side: stereo frames are processed as mid (L+R)/2 and side (L-R)/2, each spectrum with its own mode
+// (Off = passed through without any spectral work) and depth (scales the band weights), instead of the band modes
+const struct
+{
+	const std::string ID = "MidSideID";
+	const std::string name = "Mid/Side";
+	const bool defaultValue = false;
+}g_paramMidSide;
+
+const struct
+{
+	const std::string ID[2] = {"MidModeID", "SideModeID"};
+	const std::string name[2] = {"Mid Mode", "Side Mode"};
+	const std::string modeOff = "Off"; // followed by the modes of g_paramMode
+	const int defaultValue[2] = {0, 3}; // mid untouched, side random
+}g_paramMidSideMode;
+
+const struct
+{
+	const std::string ID[2] = {"MidDepthID", "SideDepthID"};
+	const std::string name[2] = {"Mid Depth", "Side Depth"};
+	const float defaultValue = 1;
+	const float minValue = 0;
+	const float maxValue = 1;
+}g_paramMidSideDepth;
+
+// silence gate: frames with a mean power (RMS in dBFS) below the close threshold for g_silenceHoldFrames frames
+// are passed through without spectral processing, processing resumes above the open threshold
+const float g_silenceCloseThreshold_dB = -100.0f;
+const float g_silenceOpenThreshold_dB = -90.0f;
+const int g_silenceHoldFrames = 2;
+
 class OutOfPhaseAudio : public WOLA
 {
 public:
     OutOfPhaseAudio(OutOfPhaseAudioProcessor* processor);
-    void prepareToPlay(double sampleRate, int max_samplesPerBlock, int max_channels);
+    ~OutOfPhaseAudio();
+    // may be called while the audio thread runs (e.g. blocksize from the GUI), the new configuration
+    // is handed over between two callbacks, all buffers are sized for the channels of the layout
+    void prepareToPlay(double sampleRate, int max_samplesPerBlock, const juce::AudioChannelSet& layout);
+    // message thread: rebuilds the engine (e.g. new blocksize) under the configuration epoch,
+    // the new latency is reported to the host when it is done
+    void requestRebuild(int max_channels);
 	
 	virtual int processWOLA(juce::AudioBuffer<float>& inBlock, juce::MidiBuffer& midiMessages);
+	// call this instead of processBlock: runs the WOLA engine or the latency compensated bypass
+	// forceBypass is set by the host bypass (processBlockBypassed)
+	void processWithBypass(juce::AudioBuffer<float>& data, juce::MidiBuffer& midiMessages, bool forceBypass = false);
+	// audio thread, before processWithBypass while the transport plays: a transport start or a jump
+	// (loop, seek) realigns the frames to the host timeline
+	void syncToHostPosition(int64_t position);
 
     // parameter handling
   	void addParameter(std::vector < std::unique_ptr<juce::RangedAudioParameter>>& paramVector);
@@ -101,57 +259,233 @@ public:
 
 	void updateFrequencyRange(double sampleRate);
 
-	std::vector<float> getPrePhaseData() {
-        juce::ScopedLock lock(dataMutex);
-        return m_PrePhaseData;
-	}
-
-	std::vector<float> getPostPhaseData() {
-        juce::ScopedLock lock(dataMutex);
-        return m_PostPhaseData;
-	}
+	// the phase display has its own analysis (own FFT, background job on the worker pool), fed by the processor
+	PhaseAnalyzer& getPhaseAnalyzer() { return m_phaseAnalyzer; }
 
-	void acquireLock()
-    {
-        dataMutex.enter();
-    }
-    
-    void releaseLock()
-    {
-        dataMutex.exit();
-    }
-	
+	// frost capture: the GUI only requests a snapshot, the audio thread fills the inactive slot
+	// from the next frame and publishes it with a single atomic store (no lock on either side)
 	void updateFrostPhaseData() {
-		juce::ScopedLock lock(dataMutex);
-		m_FrostPhaseData = m_PrePhaseData;
+		m_frostCaptureRequested.store(true, std::memory_order_release);
 	}
 
+	// not realtime safe (resizes), only called from prepareToPlay
 	void initFrostPhaseData() {
-		juce::ScopedLock lock(dataMutex);
-		m_FrostPhaseData.resize(m_synchronblocksize/2+1);
-		std::fill(m_FrostPhaseData.begin(), m_FrostPhaseData.end(), 0.0f);
-		//DBG("FrostPhaseData size: " << m_FrostPhaseData.size());
+		for (int slot = 0; slot < 2; ++slot)
+		{
+			m_FrostPhasorReal[slot].assign(static_cast<size_t>(m_synchronblocksize/2+1), 1.0f);
+			m_FrostPhasorImag[slot].assign(static_cast<size_t>(m_synchronblocksize/2+1), 0.0f);
+		}
+		m_frostActiveSlot.store(0, std::memory_order_release);
 	}
 
 private:
 	OutOfPhaseAudioProcessor* m_processor;
     int m_Latency = 0;
+	double m_fs = 48000.0;
+
+	// parameter handling: pointers are cached in prepareParameter, values are read once per hop
+	// except the automatable continuous ones: they are recorded at every host block and read at the
+	// position of the frame (band frequencies and depths at its centre, dry/wet as a ramp per sample)
+	jade::AudioProcessParameter<float> m_paramMode[g_maxNumberOfBands];
+	jade::AudioProcessParameter<float> m_paramDistributionMode[g_maxNumberOfBands];
+	ParameterTimeline m_paramLowFreq[g_maxNumberOfBands];
+	ParameterTimeline m_paramHighFreq[g_maxNumberOfBands];
+	ParameterTimeline m_paramDepth[g_maxNumberOfBands];
+	ParameterTimeline m_paramDryWet;
+	void recordAutomation(int numSamples);
+	jade::AudioProcessParameter<float> m_paramBandMode;
+	jade::AudioProcessParameter<float> m_paramNumBands;
+	jade::AudioProcessParameter<float> m_paramSeed;
+	jade::AudioProcessParameter<float> m_paramChannelLink;
+	jade::AudioProcessParameter<float> m_paramPreserveImage;
+	jade::AudioProcessParameter<float> m_paramMidSide;
+	jade::AudioProcessParameter<float> m_paramMidSideMode[2];
+	jade::AudioProcessParameter<float> m_paramMidSideDepth[2];
+	std::atomic<float>* m_paramBypass = nullptr;
+
+	struct BandSnapshot
+	{
+		int mode = 0;
+		int distribution = 0;
+		float lowFreq = 0.f;
+		float highFreq = 0.f;
+		float depth = 1.f;
+	};
+	struct ParameterSnapshot
+	{
+		// band 0 is used for the whole spectrum if band mode is off
+		BandSnapshot bands[g_maxNumberOfBands];
+		int numBands = 1;
+		bool bandMode = false;
+		int seed = 0;
+		int channelLink = 0;
+		bool preserveImage = false;
+		bool midSide = false;
+		int midSideMode[2] = {-1, 2}; // -1: untouched
+		float midSideDepth[2] = {1.f, 1.f};
+		// dirty flags, true if something changed since the last hop
+		bool bandChanged = true; // bandmode, number of bands, frequencies, depths, blocksize or sampling rate
+		bool seedChanged = true;
+	} m_params;
+	bool m_configChanged = true; // set by prepareToPlay, forces all derived data to be rebuilt
+	void updateParameterSnapshot(int64_t frameCentre);
+
+	// effect weight and band index per bin, derived from the band parameters (only recomputed if bandChanged)
+	// bins with weight 0 (e.g. outside [m_firstBandBin, m_lastBandBin]) are passed through untouched
+	void updateBandWeights();
+	std::vector<float> m_bandWeights;
+	std::vector<int8_t> m_binBand;
+	int m_firstBandBin = 0;
+	int m_lastBandBin = -1;
+	int m_bandFirstBin[g_maxNumberOfBands];
+	int m_bandLastBin[g_maxNumberOfBands];
+
+	bool isSilentFrame(const juce::AudioBuffer<float>& data);
+	float m_silenceClosePower = 0.0f;
+	float m_silenceOpenPower = 0.0f;
+	bool m_silent = false;
+	int m_silentFrames = 0;
+
+	// channel link: the random phases of a channel come from the phase field of its leader
+	enum ChannelLink
+	{
+		kLinkOff = 0,
+		kLinkGroups,
+		kLinkAll,
+	};
+	ChannelGroups m_channelGroups; // groups of the bus layout
+	int getLinkLeader(int channel) const;
+	void drawRandomPhases(int channel);
+	// audio thread, before the channels are processed: draws the field of every leader once and turns it into phasors
+	void drawLinkedPhases(int numchns);
+	juce::AudioBuffer<float> m_linkedPhasorReal; // one channel per leader
+	juce::AudioBuffer<float> m_linkedPhasorImag;
+	// preserve image: input phase of the leaders as unit phasors (written by the FFT stage of the leader)
+	void captureLeaderPhasors(const float* realPtr, const float* imagPtr, int leader);
+	juce::AudioBuffer<float> m_leaderPhasorReal;
+	juce::AudioBuffer<float> m_leaderPhasorImag;
+
+	// mid/side: the frame is encoded in place before the FFT and decoded when the frame is finished
+	bool isMidSideChannelActive(int channel) const;
+	// mode of a bin of the channel: the band mode, or the mode of the mid/side spectrum
+	int getChannelMode(int channel, int band) const;
+	void encodeMidSide(juce::AudioBuffer<float>& data);
+	void decodeMidSide(juce::AudioBuffer<float>& data);
+
+	// Flip without band mode: circular time reversal of the frame instead of FFT -> conj -> iFFT
+	void flipTimeDomain(spectrum& fft, float* frame, float* realPtr, float* imagPtr, bool captureFrost, int frostSlot);
+	void mixDryWet(float* wet, const float* dry, int numSamples, float dryWetMix);
+	void mixDryWet(float* wet, const float* dry, int numSamples, const float* dryWetMix);
+	std::vector<float> m_dryWetRamp; // of the frame in work, per sample
+
+	ConfigEpoch m_configEpoch;
+	LatencyBypass m_bypass;
+	int m_bypassChannels = 0;
+	double m_bypassSampleRate = 0.0;
+	void processChunk(juce::AudioBuffer<float>& data, juce::MidiBuffer& midiMessages, bool bypassed);
+	bool m_timelineJumped = false; // audio thread only, the engine is reset in the next chunk
+
+	// processing of one frame in stages (per channel: FFT, spectral kernel, iFFT + dry/wet),
+	// all at once, spread over the next hop (Spread) or by the worker during the next hop (Worker),
+	// Inline and Worker fan the units out to several pool threads for large frames
+	// a unit is a channel, or a whole link group if the image is preserved (its channels need the leader's phase),
+	// every stage is run for all channels of a unit
+	enum Scheduling
+	{
+		kSchedulingInline = 0,
+		kSchedulingSpread,
+		kSchedulingWorker,
+	};
+	static constexpr int kStagesPerChannel = 3;
+	struct FrameJob : public WorkerPool::Job
+	{
+		OutOfPhaseAudio* owner = nullptr;
+		juce::AudioBuffer<float>* data = nullptr;
+		int numChannels = 0;
+		int numUnits = 0;
+		int numStages = 0; // 0: nothing to do (e.g. silent frame)
+		int nextStage = 0; // not pooled (audio thread only)
+		// pooled: units are claimed by the pool threads and the audio thread,
+		// claimState = generation (32 bit) | number of units (16 bit) | next unit (16 bit)
+		bool pooled = false;
+		std::atomic<uint64_t> claimState{0};
+		uint32_t generation = 0;
+		std::atomic<int> unitsDone{0};
+		juce::WaitableEvent unitsFinished; // signalled with the last unit of a frame
+		std::atomic<int> pendingRuns{0}; // submitted and not yet finished, the instance must outlive them
+		int64_t frameIndex = 0;
+		float dryWet = 1.f;
+		bool dryWetRamp = false; // dry/wet changes within the frame (m_dryWetRamp)
+		bool timeDomainFlip = false;
+		bool linkedRandom = false; // random bands use the phasors of the link leaders
+		bool preserveImage = false;
+		bool midSide = false; // the frame holds mid and side
+		int frostChannel = 0; // the last processed channel
+		bool captureFrost = false;
+		int frostSlot = 0;
+		void run() override;
+	} m_job;
+	void beginFrame(juce::AudioBuffer<float>& data);
+	// number of pool threads that should work on the frame (0: the audio thread does it alone)
+	int getNumFrameRuns() const;
+	// opens the units for claiming and submits the job numRuns times
+	void submitFrame(int numRuns, juce::int64 deadlineTicks);
+	// audio thread: channels of every unit (m_unitChannels[m_unitStart[u]] ... m_unitChannels[m_unitStart[u+1]-1])
+	void buildUnits(int numchns);
+	std::vector<int> m_unitChannels;
+	std::vector<int> m_unitStart;
+	void runFrameStages(int untilStage);
+	void runUnitStage(int unit, int stage);
+	void runStage(int channel, int stage);
+	// claims whole units of the job until none is left (any thread)
+	void processClaimedUnits();
+	// audio thread: finishes all remaining work of the job (waits for units the pool is busy with)
+	void completeFrame();
+	void finishFrame();
+	void processSpectrum(float* realPtr, float* imagPtr, int channel, const float* frostReal, const float* frostImag);
+	void advanceAmortizedWork();
+	// realtime safe reset of the engine (after a bypass)
+	void resetFrameProcessing();
+	void clearJob();
+	int m_scheduling = kSchedulingInline;
+	juce::AudioBuffer<float> m_amortizedFrame[2];
+	int m_amortizedSlot = 0;
+	// shared by all instances (spectral frames and the display analysis)
+	juce::SharedResourcePointer<WorkerPool> m_pool;
+
+	void rebuildEngine(double sampleRate, int max_channels);
 
 	int m_synchronblocksize = 0;
-	spectrum m_fftprocess;
+	juce::AudioBuffer<float> m_dryBuffer;
 	juce::AudioBuffer<float> m_realdata;
 	juce::AudioBuffer<float> m_imagdata;
 
-	std::vector<float> m_PrePhaseData;
-	std::vector<float> m_PostPhaseData;
+	PhaseAnalyzer m_phaseAnalyzer;
 
-	std::vector<float> m_tempPrePhaseData;
-	std::vector<float> m_tempPostPhaseData;
+	// captured phases as unit phasors (double buffered), so frost needs no trigonometry per hop
+	void captureFrostPhasors(const float* realPtr, const float* imagPtr, int slot);
+	// phasors of zero bins are (1, 0)
+	static void computeUnitPhasors(const float* realPtr, const float* imagPtr, float* phasorReal, float* phasorImag, int numBins);
+	std::vector<float> m_FrostPhasorReal[2];
+	std::vector<float> m_FrostPhasorImag[2];
+	std::atomic<int> m_frostActiveSlot{0};
+	std::atomic<bool> m_frostCaptureRequested{false};
 
-	std::vector<float> m_FrostPhaseData;
-	juce::CriticalSection dataMutex;
+	// everything a channel needs for its own, so channels can be processed on different threads
+	// (FFT scratch, random generator and random phases)
+	struct ChannelState
+	{
+		spectrum fft;
+		PhaseRandom random;
+		std::vector<float> randomPhases;
+	};
+	std::vector<ChannelState> m_channelState;
 };
 
+// item IDs of the mid/side entries of the analysis source box (channels use channel index + 1)
+const int g_analysisSourceMidItem = 1001;
+const int g_analysisSourceSideItem = 1002;
+
 class OutOfPhaseGUI : public juce::Component, public juce::Timer
 {
 public:
@@ -162,6 +496,7 @@ public:
 	void paint(juce::Graphics& g) override;
 	void resized() override;
 	void parentHierarchyChanged() override;
+	void visibilityChanged() override;
 	void updateModeButtonStates();
 
 	void updateFrequencyKnobRanges(double sampleRate)
@@ -173,6 +508,10 @@ public:
 	void timerCallback() override;
 
 private:
+	// connects the band controls to the parameters of the given band
+	void selectBand(int band);
+	float getSelectedBandValue(const std::string& baseID);
+
 	OutOfPhaseAudioProcessor& m_processor;
     juce::AudioProcessorValueTreeState& m_apvts;
 
@@ -182,10 +521,28 @@ private:
 	
 	DiscreteSlider m_BlocksizeSlider;
 	std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> BlocksizeSliderAttachment;
+	juce::ComboBox m_SchedulingBox;
+	std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> SchedulingBoxAttachment;
+	juce::ComboBox m_ChannelLinkBox;
+	std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> ChannelLinkBoxAttachment;
+	juce::ToggleButton m_PreserveImageButton;
+	std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> PreserveImageButtonAttachment;
+	// mid/side: mid controls left, side controls right of the post phase plot
+	juce::ToggleButton m_MidSideButton;
+	std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> MidSideButtonAttachment;
+	juce::ComboBox m_MidSideModeBox[2];
+	std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> MidSideModeBoxAttachment[2];
+	CustomSlider m_MidSideDepthSlider[2];
+	std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> MidSideDepthSliderAttachment[2];
 	CustomSlider m_DryWetSlider;
 	std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> DryWetSliderAttachment;
 	PhasePlot m_PrePhasePlot;
 	PhasePlot m_PostPhasePlot;
+	juce::ComboBox m_AnalysisSourceBox;
+	int m_analysisSource = PhaseAnalyzer::kSourceNone;
+	// registered as analysis consumer while the editor is showing
+	void updateAnalysisConsumer();
+	bool m_isAnalysisConsumer = false;
 	//std::vector<float> phaseDataPlot;
 
 	std::unique_ptr<juce::TooltipWindow> tooltipWindow;
@@ -203,4 +560,9 @@ private:
 	std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> BandModeButtonAttachment;
 	std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> LowFreqKnobAttachment;
 	std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> HighFreqKnobAttachment;
+
+	BandSelector m_BandSelector;
+	CustomSlider m_DepthSlider;
+	std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> DepthSliderAttachment;
+	int m_selectedBand = 0;
 };
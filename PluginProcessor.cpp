@@ -19,6 +19,8 @@ OutOfPhaseAudioProcessor::OutOfPhaseAudioProcessor()
         AudioProcessorValueTreeState::ParameterLayout(m_paramVector.begin(), m_paramVector.end()));
 
     m_algo.prepareParameter(m_parameterVTS);
+    m_parameterVTS->addParameterListener(g_paramBlocksize.ID, this);
+    m_parameterVTS->addParameterListener(g_paramScheduling.ID, this);
 
 	m_presets.setAudioValueTreeState(m_parameterVTS.get());
     // if needed add categories, if g_PresetCategories contains one empty string "", nothing happened
@@ -35,7 +37,23 @@ OutOfPhaseAudioProcessor::OutOfPhaseAudioProcessor()
 
 OutOfPhaseAudioProcessor::~OutOfPhaseAudioProcessor()
 {
+    m_parameterVTS->removeParameterListener(g_paramBlocksize.ID, this);
+    m_parameterVTS->removeParameterListener(g_paramScheduling.ID, this);
+    cancelPendingUpdate();
+}
 
+void OutOfPhaseAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
+{
+    // may be the audio thread (automation), the rebuild itself is deferred
+    juce::ignoreUnused(parameterID, newValue);
+    triggerAsyncUpdate();
+}
+
+void OutOfPhaseAudioProcessor::handleAsyncUpdate()
+{
+    // before the first prepareToPlay there is no engine yet, prepareToPlay reads the parameters
+    if (getSampleRate() > 0)
+        m_algo.requestRebuild(getTotalNumInputChannels());
 }
 
 //==============================================================================
@@ -113,12 +131,14 @@ void OutOfPhaseAudioProcessor::prepareToPlay (double sampleRate, int samplesPerB
     // sometimes you need the number of channels.
     // Since we only support if in and output is the same, we can just ask for input
     // 
-    int nrofchannels = this->getMainBusNumOutputChannels();
-    jassert(("number of channels should never be zero", nrofchannels>0));
+    // the layout also defines the channel groups (e.g. L/R pairs, ambisonic orders)
+    auto layout = getChannelLayoutOfBus(false, 0);
+    jassert(("number of channels should never be zero", layout.size()>0));
 
     juce::ignoreUnused (samplesPerBlock);
     m_fs = static_cast<float>(sampleRate);
-    m_algo.prepareToPlay(sampleRate,samplesPerBlock,nrofchannels);
+    m_algo.prepareToPlay(sampleRate,samplesPerBlock,layout);
+    setLatencySamples(m_algo.getLatency());
 }
 
 void OutOfPhaseAudioProcessor::releaseResources()
@@ -134,9 +154,9 @@ bool OutOfPhaseAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
     return true;
   #else
     // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any layout up to g_maxNumberOfChannels: mono, stereo, surround (e.g. 5.1, 7.1.4), ambisonics up to third order
+    const auto& mainOutput = layouts.getMainOutputChannelSet();
+    if (mainOutput.isDisabled() || mainOutput.size() > g_maxNumberOfChannels)
         return false;
 
     // This checks if the input layout matches the output layout
@@ -149,8 +169,26 @@ bool OutOfPhaseAudioProcessor::isBusesLayoutSupported (const BusesLayout& layout
   #endif
 }
 
+juce::AudioParameterBool* OutOfPhaseAudioProcessor::getBypassParameter() const
+{
+    return dynamic_cast<juce::AudioParameterBool*>(m_parameterVTS->getParameter(g_paramBypass.ID));
+}
+
 void OutOfPhaseAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
                                               juce::MidiBuffer& midiMessages)
+{
+    process(buffer, midiMessages, false);
+}
+
+// some hosts call this instead of setting the bypass parameter, the same crossfaded path is used
+void OutOfPhaseAudioProcessor::processBlockBypassed (juce::AudioBuffer<float>& buffer,
+                                                      juce::MidiBuffer& midiMessages)
+{
+    process(buffer, midiMessages, true);
+}
+
+void OutOfPhaseAudioProcessor::process (juce::AudioBuffer<float>& buffer,
+                                         juce::MidiBuffer& midiMessages, bool forceBypass)
 {
  #if WITH_MIDIKEYBOARD  
 	m_keyboardState.processNextMidiBuffer(midiMessages, 0, buffer.getNumSamples(), true);
@@ -179,7 +217,24 @@ void OutOfPhaseAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer,
     // Alternatively, you can process the samples with the channels
     // interleaved by keeping the same state.
 
-    m_algo.processBlock(buffer,midiMessages);
+    // the host position keeps the random phase deterministic (same seed -> same render),
+    // a stopped transport often reports a constant position: the engine keeps counting on its own
+    if (auto* playHead = getPlayHead())
+        if (auto position = playHead->getPosition())
+            if (position->getIsPlaying())
+                if (auto timeInSamples = position->getTimeInSamples())
+                    m_algo.syncToHostPosition(*timeInSamples);
+
+    // the phase display is analysed on the worker pool, only while an editor shows it
+    auto& analyzer = m_algo.getPhaseAnalyzer();
+    bool analyse = analyzer.isActive();
+    if (analyse)
+        analyzer.pushInput(buffer);
+
+    m_algo.processWithBypass(buffer,midiMessages,forceBypass);
+
+    if (analyse)
+        analyzer.pushOutput(buffer);
 
 #if WITH_MIDIKEYBOARD  
     midiMessages.clear(); // except you want to create new midi messages, but than say so 
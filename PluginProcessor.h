@@ -6,7 +6,9 @@
 #include "OutOfPhase.h"
 
 //==============================================================================
-class OutOfPhaseAudioProcessor  : public juce::AudioProcessor
+class OutOfPhaseAudioProcessor  : public juce::AudioProcessor,
+                                  private juce::AudioProcessorValueTreeState::Listener,
+                                  private juce::AsyncUpdater
 {
 public:
     friend class OutOfPhaseAudioProcessorEditor;
@@ -21,7 +23,12 @@ public:
     bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlockBypassed (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
     using AudioProcessor::processBlock;
+    using AudioProcessor::processBlockBypassed;
+
+    // the host bypass is the plugin's own soft bypass (latency compensated, crossfaded)
+    juce::AudioParameterBool* getBypassParameter() const override;
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -53,6 +60,11 @@ public:
     OutOfPhaseAudio m_algo;
     std::unique_ptr<AudioProcessorValueTreeState> m_parameterVTS;
 private:
+    void process(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages, bool forceBypass);
+    // blocksize and scheduling (GUI, automation, restored state) rebuild the engine on the message thread
+    void parameterChanged(const juce::String& parameterID, float newValue) override;
+    void handleAsyncUpdate() override;
+
     CriticalSection m_protect;
     float m_fs; // sampling rate is always needed
 
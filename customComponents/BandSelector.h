@@ -0,0 +1,128 @@
+#pragma once
+
+#include <functional>
+#include <juce_gui_basics/juce_gui_basics.h>
+
+// Selects the band that is shown by the band controls (frequency knobs, depth, mode buttons)
+// and adds or removes bands
+class BandSelector : public juce::Component
+{
+public:
+    BandSelector()
+    {
+        m_prevButton.setButtonText("<");
+        m_prevButton.setTooltip("Previous band");
+        m_prevButton.onClick = [this] { setSelectedBand(m_selectedBand - 1); };
+        addAndMakeVisible(m_prevButton);
+
+        m_nextButton.setButtonText(">");
+        m_nextButton.setTooltip("Next band");
+        m_nextButton.onClick = [this] { setSelectedBand(m_selectedBand + 1); };
+        addAndMakeVisible(m_nextButton);
+
+        m_removeButton.setButtonText("-");
+        m_removeButton.setTooltip("Remove the last band");
+        m_removeButton.onClick = [this] {
+            if (m_numBands > 1 && onNumBandsChanged)
+                onNumBandsChanged(m_numBands - 1);
+        };
+        addAndMakeVisible(m_removeButton);
+
+        m_addButton.setButtonText("+");
+        m_addButton.setTooltip("Add a band");
+        m_addButton.onClick = [this] {
+            if (m_numBands < m_maxNumBands && onNumBandsChanged)
+                onNumBandsChanged(m_numBands + 1);
+        };
+        addAndMakeVisible(m_addButton);
+
+        for (auto* button : { &m_prevButton, &m_nextButton, &m_removeButton, &m_addButton })
+        {
+            button->setColour(juce::TextButton::buttonColourId, juce::Colours::darkgrey.brighter(0.3f));
+            button->setColour(juce::TextButton::textColourOffId, juce::Colours::white);
+        }
+        updateButtonStates();
+    }
+
+    void setMaxNumBands(int maxNumBands)
+    {
+        m_maxNumBands = juce::jmax(1, maxNumBands);
+        setNumBands(m_numBands);
+    }
+
+    // called with the new number of bands, the owner writes the parameter
+    std::function<void(int)> onNumBandsChanged;
+    // called with the new selected band (0 based)
+    std::function<void(int)> onBandSelected;
+
+    void setNumBands(int numBands)
+    {
+        numBands = juce::jlimit(1, m_maxNumBands, numBands);
+        if (numBands == m_numBands)
+            return;
+
+        m_numBands = numBands;
+        if (m_selectedBand >= m_numBands)
+            setSelectedBand(m_numBands - 1);
+        updateButtonStates();
+        repaint();
+    }
+    int getNumBands() const { return m_numBands; }
+
+    void setSelectedBand(int band)
+    {
+        band = juce::jlimit(0, m_numBands - 1, band);
+        if (band == m_selectedBand)
+            return;
+
+        m_selectedBand = band;
+        updateButtonStates();
+        repaint();
+        if (onBandSelected)
+            onBandSelected(m_selectedBand);
+    }
+    int getSelectedBand() const { return m_selectedBand; }
+
+    void paint(juce::Graphics& g) override
+    {
+        auto textBounds = m_labelBounds.toFloat();
+        g.setFont(juce::Font(juce::FontOptions(textBounds.getHeight() * 0.6f, juce::Font::bold)));
+
+        juce::String text = "BAND " + juce::String(m_selectedBand + 1) + "/" + juce::String(m_numBands);
+        g.setColour(juce::Colours::black.withAlpha(0.5f));
+        g.drawText(text, textBounds.translated(1, 1), juce::Justification::centred);
+        g.setColour(juce::Colours::white.withAlpha(0.9f));
+        g.drawText(text, textBounds, juce::Justification::centred);
+    }
+
+    void resized() override
+    {
+        auto r = getLocalBounds();
+        int buttonWidth = r.getHeight();
+
+        m_prevButton.setBounds(r.removeFromLeft(buttonWidth));
+        m_addButton.setBounds(r.removeFromRight(buttonWidth));
+        m_removeButton.setBounds(r.removeFromRight(buttonWidth));
+        m_nextButton.setBounds(r.removeFromRight(buttonWidth));
+        m_labelBounds = r;
+    }
+
+private:
+    void updateButtonStates()
+    {
+        m_prevButton.setEnabled(m_selectedBand > 0);
+        m_nextButton.setEnabled(m_selectedBand < m_numBands - 1);
+        m_removeButton.setEnabled(m_numBands > 1);
+        m_addButton.setEnabled(m_numBands < m_maxNumBands);
+    }
+
+    juce::TextButton m_prevButton;
+    juce::TextButton m_nextButton;
+    juce::TextButton m_removeButton;
+    juce::TextButton m_addButton;
+    juce::Rectangle<int> m_labelBounds;
+
+    int m_maxNumBands = 8;
+    int m_numBands = 1;
+    int m_selectedBand = 0;
+};
@@ -6,18 +6,47 @@ PhasePlot::PhasePlot()
     m_glassImage = juce::ImageFileFormat::loadFrom(glass_texture2_bin, glass_texture2_bin_len);
 }
 
-void PhasePlot::setPrePhaseData(const std::vector<float>& newPrePhaseData)
+void PhasePlot::setPrePhaseData(const float* newPhaseMin, const float* newPhaseMax, int numColumns)
 {
-    PrePhaseData = newPrePhaseData;
+    PrePhaseMin.assign(newPhaseMin, newPhaseMin + numColumns);
+    PrePhaseMax.assign(newPhaseMax, newPhaseMax + numColumns);
     repaint();
 }
 
-void PhasePlot::setPostPhaseData(const std::vector<float>& newPostPhaseData)
+void PhasePlot::setPostPhaseData(const float* newPhaseMin, const float* newPhaseMax, int numColumns)
 {
-    PostPhaseData = newPostPhaseData;
+    PostPhaseMin.assign(newPhaseMin, newPhaseMin + numColumns);
+    PostPhaseMax.assign(newPhaseMax, newPhaseMax + numColumns);
     repaint();
 }
 
+// the columns are already log-spaced, every column is drawn as a vertical stroke from min to max
+juce::Path PhasePlot::createColumnPath(const std::vector<float>& phaseMin, const std::vector<float>& phaseMax,
+                                       juce::Rectangle<int> clipBounds, float margin)
+{
+    juce::Path path;
+    size_t numColumns = std::min(phaseMin.size(), phaseMax.size());
+    if (numColumns < 2)
+        return path;
+
+    float plotWidth = clipBounds.getWidth() - 2 * margin;
+    float centerY = clipBounds.getY() + clipBounds.getHeight() / 2.0f;
+    float scaleY = clipBounds.getHeight() / 2.0f;
+
+    for (size_t cc = 0; cc < numColumns; ++cc)
+    {
+        float x = clipBounds.getX() + margin + static_cast<float>(cc) / static_cast<float>(numColumns - 1) * plotWidth;
+        float yMin = centerY - phaseMin[cc] * scaleY;
+        float yMax = centerY - phaseMax[cc] * scaleY;
+        if (cc == 0)
+            path.startNewSubPath(x, yMin);
+        else
+            path.lineTo(x, yMin);
+        path.lineTo(x, yMax);
+    }
+    return path;
+}
+
 void PhasePlot::paint(juce::Graphics& g)
 {
     bool mouseOver = isMouseOver();
@@ -60,109 +89,34 @@ void PhasePlot::paint(juce::Graphics& g)
     g.setColour(juce::Colours::white);
     g.setOpacity(0.5f);
 
-    if (!PrePhaseData.empty())
-    {
-        auto width = static_cast<float>(clipBounds.getWidth());
-        auto height = static_cast<float>(clipBounds.getHeight());
-        size_t N = PrePhaseData.size();
-
-        juce::Path PrePhasePath;
-
-        float logMin = static_cast<float>(std::log10(1.0f));
-        float logMax = static_cast<float>(std::log10(static_cast<float>(N)));
-
-        float margin;
-        if (mouseOver) {
-            juce::Font labelFont(juce::FontOptions(15.0f));
-            juce::GlyphArrangement glyphArrangement;
-            glyphArrangement.addLineOfText(labelFont, "0", 0.0f, 0.0f);
-            float zeroWidth = glyphArrangement.getBoundingBox(0, 1, true).getWidth();
-            glyphArrangement.clear();
-            
-            juce::String nyquistLabel;
-            if (m_sampleRate >= 2000) {
-                nyquistLabel = juce::String(m_sampleRate / 2000.0f, 1) + " kHz";
-            } else {
-                nyquistLabel = juce::String(m_sampleRate / 2) + " Hz";
-            }
-            
-            glyphArrangement.addLineOfText(labelFont, nyquistLabel, 0.0f, 0.0f);
-            float fsWidth = glyphArrangement.getBoundingBox(0, nyquistLabel.length(), true).getWidth() - 10.0f;
-            margin = std::max(zeroWidth, fsWidth) + 5.0f;
-        }
-        else {
-            margin = 0.0f;
-        }
-        float plotWidth = width - 2 * margin;
-
-        float xStart = clipBounds.getX() + margin + (static_cast<float>(std::log10(1.0f)) - logMin) / (logMax - logMin) * plotWidth;
-        float yStart = clipBounds.getY() + height / 2 - (PrePhaseData[0] * (height / 2));
-        PrePhasePath.startNewSubPath(xStart, yStart);
-
-        for (size_t i = 1; i < N; ++i)
-        {
-            float logIndex = static_cast<float>(std::log10(i + 1));
-            float normX = (logIndex - logMin) / (logMax - logMin);
-            float x = clipBounds.getX() + margin + normX * plotWidth;
-            float y = clipBounds.getY() + height / 2 - (PrePhaseData[i] * (height / 2));
-
-            PrePhasePath.lineTo(x, y);
+    float margin = 0.0f;
+    if (mouseOver) {
+        juce::Font labelFont(juce::FontOptions(15.0f));
+        juce::GlyphArrangement glyphArrangement;
+        glyphArrangement.addLineOfText(labelFont, "0", 0.0f, 0.0f);
+        float zeroWidth = glyphArrangement.getBoundingBox(0, 1, true).getWidth();
+        glyphArrangement.clear();
+        
+        juce::String nyquistLabel;
+        if (m_sampleRate >= 2000) {
+            nyquistLabel = juce::String(m_sampleRate / 2000.0f, 1) + " kHz";
+        } else {
+            nyquistLabel = juce::String(m_sampleRate / 2) + " Hz";
         }
-
-        g.strokePath(PrePhasePath, juce::PathStrokeType(1.0f));
+        
+        glyphArrangement.addLineOfText(labelFont, nyquistLabel, 0.0f, 0.0f);
+        float fsWidth = glyphArrangement.getBoundingBox(0, nyquistLabel.length(), true).getWidth() - 10.0f;
+        margin = std::max(zeroWidth, fsWidth) + 5.0f;
     }
 
+    if (!PrePhaseMin.empty())
+        g.strokePath(createColumnPath(PrePhaseMin, PrePhaseMax, clipBounds, margin), juce::PathStrokeType(1.0f));
+
     g.setColour(juce::Colours::white);
     g.setOpacity(0.5f);
 
-    if (!PostPhaseData.empty())
-    {
-        size_t N = PostPhaseData.size();
-        juce::Path PostPhasePath;
-
-        float logMin = static_cast<float>(std::log10(1.0f));
-        float logMax = static_cast<float>(std::log10(static_cast<float>(N)));
-
-        float margin;
-        if (mouseOver) {
-            juce::Font labelFont(juce::FontOptions(15.0f));
-            juce::GlyphArrangement glyphArrangement;
-            glyphArrangement.addLineOfText(labelFont, "0", 0.0f, 0.0f);
-            float zeroWidth = glyphArrangement.getBoundingBox(0, 1, true).getWidth();
-            glyphArrangement.clear();
-            
-            juce::String nyquistLabel;
-            if (m_sampleRate >= 2000) {
-                nyquistLabel = juce::String(m_sampleRate / 2000.0f, 1) + " kHz";
-            } else {
-                nyquistLabel = juce::String(m_sampleRate / 2) + " Hz";
-            }
-            
-            glyphArrangement.addLineOfText(labelFont, nyquistLabel, 0.0f, 0.0f);
-            float fsWidth = glyphArrangement.getBoundingBox(0, nyquistLabel.length(), true).getWidth() - 10.0f;
-            margin = std::max(zeroWidth, fsWidth) + 5.0f;
-        }
-        else {
-            margin = 0.0f;
-        }
-        float plotWidth = clipBounds.getWidth() - 2 * margin;
-
-        float xStart = clipBounds.getX() + margin + (static_cast<float>(std::log10(1)) - logMin) / (logMax - logMin) * plotWidth;
-        float yStart = clipBounds.getY() + clipBounds.getHeight() / 2 - (PostPhaseData[0] * (clipBounds.getHeight() / 2));
-        PostPhasePath.startNewSubPath(xStart, yStart);
-
-        for (size_t i = 1; i < N; ++i)
-        {
-            float logIndex = static_cast<float>(std::log10(i + 1));
-            float normX = (logIndex - logMin) / (logMax - logMin);
-            float x = clipBounds.getX() + margin + normX * plotWidth;
-            float y = clipBounds.getY() + clipBounds.getHeight() / 2 - (PostPhaseData[i] * (clipBounds.getHeight() / 2));
-
-            PostPhasePath.lineTo(x, y);
-        }
-
-        g.strokePath(PostPhasePath, juce::PathStrokeType(1.0f));
-    }
+    if (!PostPhaseMin.empty())
+        g.strokePath(createColumnPath(PostPhaseMin, PostPhaseMax, clipBounds, margin), juce::PathStrokeType(1.0f));
     
     if (mouseOver)
     {
@@ -8,8 +8,9 @@ class PhasePlot : public juce::Component
 public:
     PhasePlot();
 
-    void setPrePhaseData(const std::vector<float>& newPrePhaseData);
-    void setPostPhaseData(const std::vector<float>& newPostPhaseData);
+    // phase data as log-spaced columns (min and max per column)
+    void setPrePhaseData(const float* newPhaseMin, const float* newPhaseMax, int numColumns);
+    void setPostPhaseData(const float* newPhaseMin, const float* newPhaseMax, int numColumns);
     void paint(juce::Graphics& g) override;
 
     void setSampleRate(double sampleRate) 
@@ -19,8 +20,12 @@ public:
     }
 
 private:
-    std::vector<float> PrePhaseData;
-    std::vector<float> PostPhaseData;
+    std::vector<float> PrePhaseMin;
+    std::vector<float> PrePhaseMax;
+    std::vector<float> PostPhaseMin;
+    std::vector<float> PostPhaseMax;
+    juce::Path createColumnPath(const std::vector<float>& phaseMin, const std::vector<float>& phaseMax,
+                                juce::Rectangle<int> clipBounds, float margin);
     juce::Image m_glassImage;
     void drawGrid(juce::Graphics& g);
     double m_sampleRate = 48000.0;
@@ -0,0 +1,62 @@
+#include <cmath>
+#include "ChannelGroups.h"
+
+namespace
+{
+    using CT = juce::AudioChannelSet::ChannelType;
+
+    // left/right partners of the same layer
+    const std::pair<CT, CT> kChannelPairs[] =
+    {
+        { juce::AudioChannelSet::left, juce::AudioChannelSet::right },
+        { juce::AudioChannelSet::leftCentre, juce::AudioChannelSet::rightCentre },
+        { juce::AudioChannelSet::leftSurround, juce::AudioChannelSet::rightSurround },
+        { juce::AudioChannelSet::leftSurroundSide, juce::AudioChannelSet::rightSurroundSide },
+        { juce::AudioChannelSet::leftSurroundRear, juce::AudioChannelSet::rightSurroundRear },
+        { juce::AudioChannelSet::wideLeft, juce::AudioChannelSet::wideRight },
+        { juce::AudioChannelSet::topFrontLeft, juce::AudioChannelSet::topFrontRight },
+        { juce::AudioChannelSet::topSideLeft, juce::AudioChannelSet::topSideRight },
+        { juce::AudioChannelSet::topRearLeft, juce::AudioChannelSet::topRearRight },
+        { juce::AudioChannelSet::bottomFrontLeft, juce::AudioChannelSet::bottomFrontRight },
+        { juce::AudioChannelSet::bottomSideLeft, juce::AudioChannelSet::bottomSideRight },
+        { juce::AudioChannelSet::bottomRearLeft, juce::AudioChannelSet::bottomRearRight },
+    };
+}
+
+ChannelGroups::ChannelGroups()
+{
+    setLayout(juce::AudioChannelSet::stereo());
+}
+
+void ChannelGroups::setLayout(const juce::AudioChannelSet& layout)
+{
+    int numChannels = layout.size();
+    m_leader.resize(static_cast<size_t>(numChannels));
+    for (int cc = 0; cc < numChannels; ++cc)
+        m_leader[static_cast<size_t>(cc)] = cc;
+
+    if (layout.getAmbisonicOrder() >= 0)
+    {
+        // the channels are in ACN order, order n starts at channel n*n
+        for (int cc = 0; cc < numChannels; ++cc)
+        {
+            int order = static_cast<int>(std::sqrt(static_cast<double>(cc)));
+            m_leader[static_cast<size_t>(cc)] = order * order;
+        }
+    }
+    else if (!layout.isDiscreteLayout())
+    {
+        for (const auto& pair : kChannelPairs)
+        {
+            int first = layout.getChannelIndexForType(pair.first);
+            int second = layout.getChannelIndexForType(pair.second);
+            if (first >= 0 && second >= 0)
+                m_leader[static_cast<size_t>(juce::jmax(first, second))] = juce::jmin(first, second);
+        }
+    }
+
+    m_numGroups = 0;
+    for (int cc = 0; cc < numChannels; ++cc)
+        if (m_leader[static_cast<size_t>(cc)] == cc)
+            ++m_numGroups;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file ChannelGroups.h
+ * @brief groups of related channels of a bus layout, e.g. to share one random phase field within a group
+ * Surround: the left/right partners of a layer (L/R, Ls/Rs, Ltf/Rtf, ...) form a group, centre, LFE and
+ * channels without a partner are groups of their own.
+ * Ambisonics (ACN order): one group per order (W | Y Z X | 5 channels of order 2 | ...).
+ * Discrete layouts: every channel is its own group.
+ * The leader of a group is its first channel.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <vector>
+#include <juce_audio_basics/juce_audio_basics.h>
+
+class ChannelGroups
+{
+public:
+    ChannelGroups();
+    // not realtime safe (resizes)
+    void setLayout(const juce::AudioChannelSet& layout);
+
+    int getNumChannels() const { return static_cast<int>(m_leader.size()); }
+    int getNumGroups() const { return m_numGroups; }
+    // channels outside the layout are their own leader
+    int getLeader(int channel) const
+    {
+        return channel < static_cast<int>(m_leader.size()) ? m_leader[static_cast<size_t>(channel)] : channel;
+    }
+
+private:
+    std::vector<int> m_leader;
+    int m_numGroups = 0;
+};
@@ -0,0 +1,80 @@
+/**
+ * @file ConfigEpoch.h
+ * @brief epoch based (RCU-like) handoff of a reconfiguration between a writer thread and the audio thread
+ * The audio thread (single reader) marks every callback with an epoch counter (odd = inside a callback)
+ * and never blocks: if a reconfiguration is in progress, tryEnter() fails and the callback skips the engine.
+ * A writer announces the reconfiguration, waits for the grace period (the reader leaves the callback it is in),
+ * changes the configuration and publishes it with one release store. The next callback sees all changes.
+ * Writers may nest (e.g. a prepare that calls other prepares) and are serialized among themselves.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <atomic>
+#include <thread>
+#include <juce_core/juce_core.h>
+
+class ConfigEpoch
+{
+public:
+    // reader side (audio thread), wait-free
+    /**
+     * @brief tryEnter starts a callback
+     *
+     * @return true if the configuration may be used until exit(), false during a reconfiguration
+     * (exit() must not be called then)
+     */
+    bool tryEnter()
+    {
+        m_epoch.fetch_add(1, std::memory_order_seq_cst); // odd: inside
+        if (m_writerActive.load(std::memory_order_seq_cst))
+        {
+            m_epoch.fetch_add(1, std::memory_order_release);
+            return false;
+        }
+        return true;
+    }
+    void exit() { m_epoch.fetch_add(1, std::memory_order_release); }
+
+    // writer side (message thread or prepareToPlay), may block for the rest of one audio callback
+    void beginWrite()
+    {
+        m_writeLock.enter();
+        if (m_writeDepth++ > 0)
+            return;
+
+        m_writerActive.store(true, std::memory_order_seq_cst);
+        // grace period: a reader inside a callback may still use the old configuration
+        auto epoch = m_epoch.load(std::memory_order_seq_cst);
+        if (epoch & 1u)
+            while (m_epoch.load(std::memory_order_acquire) == epoch)
+                std::this_thread::yield();
+    }
+    void endWrite()
+    {
+        if (--m_writeDepth == 0)
+            m_writerActive.store(false, std::memory_order_release);
+        m_writeLock.exit();
+    }
+
+    // RAII for the writer side
+    class ScopedWrite
+    {
+    public:
+        explicit ScopedWrite(ConfigEpoch& epoch) : m_owner(epoch) { m_owner.beginWrite(); }
+        ~ScopedWrite() { m_owner.endWrite(); }
+
+    private:
+        ConfigEpoch& m_owner;
+        JUCE_DECLARE_NON_COPYABLE(ScopedWrite)
+    };
+
+private:
+    std::atomic<uint32_t> m_epoch{0};
+    std::atomic<bool> m_writerActive{false};
+    juce::CriticalSection m_writeLock; // writers only, never taken by the audio thread
+    int m_writeDepth = 0;
+};
@@ -0,0 +1,158 @@
+#include "LatencyBypass.h"
+
+LatencyBypass::LatencyBypass()
+{
+    prepare(2, 512, 0, 256);
+}
+
+void LatencyBypass::prepare(int channels, int maxBlockSize, int maxLatency, int fadeLength)
+{
+    m_maxLatency = juce::jmax(0, maxLatency);
+    m_delayLength = juce::jmax(1, maxBlockSize + m_maxLatency);
+    m_delayLine.setSize(channels, m_delayLength);
+    m_delayLine.clear();
+    m_writePos = 0;
+    m_latency = juce::jlimit(0, maxLatency, m_latency);
+    m_fadeLength = juce::jmax(1, fadeLength);
+    m_state = State::Active;
+    m_needsReset = false;
+    m_warmupRemaining = 0;
+    m_fadePos = 0;
+}
+
+void LatencyBypass::setLatency(int latency)
+{
+    // a larger latency would leave only a part of every block for the delay line
+    jassert(latency >= 0 && latency <= m_maxLatency);
+    latency = juce::jlimit(0, m_maxLatency, latency);
+    if (latency == m_latency)
+        return;
+    m_latency = latency;
+    // the output of the effect is not aligned anymore, warm up again (dry output in between)
+    if (m_state != State::Bypassed)
+    {
+        m_state = State::Warming;
+        m_needsReset = false;
+        m_warmupRemaining = 2 * m_latency;
+    }
+}
+
+bool LatencyBypass::processInput(const juce::AudioBuffer<float>& data, bool bypassed)
+{
+    int channels = juce::jmin(data.getNumChannels(), m_delayLine.getNumChannels());
+    m_numSamples = juce::jmin(data.getNumSamples(), m_delayLength - m_latency);
+    for (int cc = 0; cc < channels; cc++)
+    {
+        auto inPtr = data.getReadPointer(cc);
+        auto delayPtr = m_delayLine.getWritePointer(cc);
+        int pos = m_writePos;
+        for (int nn = 0; nn < m_numSamples; nn++)
+        {
+            delayPtr[pos] = inPtr[nn];
+            if (++pos == m_delayLength)
+                pos = 0;
+        }
+    }
+
+    m_needsReset = false;
+    switch (m_state)
+    {
+    case State::Active:
+        if (bypassed)
+        {
+            m_state = State::FadingOut;
+            m_fadePos = 0;
+        }
+        break;
+    case State::FadingOut:
+        if (!bypassed) // fade back from where we are
+        {
+            m_state = State::FadingIn;
+            m_fadePos = m_fadeLength - m_fadePos;
+        }
+        break;
+    case State::Bypassed:
+        if (!bypassed)
+        {
+            m_state = State::Warming;
+            m_needsReset = true;
+            m_warmupRemaining = 2 * m_latency;
+        }
+        break;
+    case State::Warming:
+        if (bypassed)
+            m_state = State::Bypassed;
+        break;
+    case State::FadingIn:
+        if (bypassed)
+        {
+            m_state = State::FadingOut;
+            m_fadePos = m_fadeLength - m_fadePos;
+        }
+        break;
+    }
+    return m_state != State::Bypassed;
+}
+
+void LatencyBypass::processOutput(juce::AudioBuffer<float>& data)
+{
+    int channels = juce::jmin(data.getNumChannels(), m_delayLine.getNumChannels());
+    int readStart = m_writePos - m_latency;
+    if (readStart < 0)
+        readStart += m_delayLength;
+
+    // gain of the effect output per sample, evaluated once for all channels
+    State state = m_state;
+    int fadePos = m_fadePos;
+    int warmupRemaining = m_warmupRemaining;
+    for (int nn = 0; nn < m_numSamples; nn++)
+    {
+        float wetGain = 1.0f;
+        switch (state)
+        {
+        case State::Active:
+            break;
+        case State::Bypassed:
+            wetGain = 0.0f;
+            break;
+        case State::Warming:
+            wetGain = 0.0f;
+            if (--warmupRemaining <= 0)
+            {
+                state = State::FadingIn;
+                fadePos = 0;
+            }
+            break;
+        case State::FadingOut:
+            wetGain = 1.0f - static_cast<float>(fadePos) / m_fadeLength;
+            if (++fadePos >= m_fadeLength)
+                state = State::Bypassed;
+            break;
+        case State::FadingIn:
+            wetGain = static_cast<float>(fadePos) / m_fadeLength;
+            if (++fadePos >= m_fadeLength)
+                state = State::Active;
+            break;
+        }
+
+        if (wetGain >= 1.0f)
+            continue;
+
+        int readPos = readStart + nn;
+        if (readPos >= m_delayLength)
+            readPos -= m_delayLength;
+        for (int cc = 0; cc < channels; cc++)
+        {
+            auto dataPtr = data.getWritePointer(cc);
+            float dry = m_delayLine.getSample(cc, readPos);
+            dataPtr[nn] = wetGain * dataPtr[nn] + (1.0f - wetGain) * dry;
+        }
+    }
+    m_state = state;
+    m_fadePos = fadePos;
+    m_warmupRemaining = warmupRemaining;
+
+    m_writePos += m_numSamples;
+    if (m_writePos >= m_delayLength)
+        m_writePos -= m_delayLength;
+}
@@ -0,0 +1,83 @@
+/**
+ * @file LatencyBypass.h
+ * @brief latency compensated soft bypass for a block based effect
+ * The input is always written into a delay line with the latency of the effect. While bypassed, the output is the
+ * delayed input and the effect does not run at all. Switching is click-free:
+ * Active -> FadingOut (crossfade wet -> delayed dry) -> Bypassed (effect off)
+ * Bypassed -> Warming (effect reset and running, output still dry, until its output is valid again)
+ * -> FadingIn (crossfade delayed dry -> wet) -> Active
+ * Usage: processInput before, processOutput after the effect; run the effect only if processInput returns true
+ * and reset it first if needsReset() is true.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+
+class LatencyBypass
+{
+public:
+    enum class State
+    {
+        Active,
+        FadingOut,
+        Bypassed,
+        Warming,
+        FadingIn,
+    };
+
+    LatencyBypass();
+    /**
+     * @brief prepare allocates the delay line (not realtime safe)
+     *
+     * @param channels
+     * @param maxBlockSize largest block given to processInput, larger blocks are processed in part by the caller
+     * @param maxLatency
+     * @param fadeLength length of the crossfade in samples
+     */
+    void prepare(int channels, int maxBlockSize, int maxLatency, int fadeLength);
+    /**
+     * @brief setLatency sets the delay of the dry path, must be the latency of the effect (<= maxLatency)
+     * restarts the warm up if the effect is running and the latency changes
+     *
+     * @param latency
+     */
+    void setLatency(int latency);
+    int getLatency(){return m_latency;}
+
+    /**
+     * @brief processInput stores the input and updates the state
+     *
+     * @param data input block
+     * @param bypassed bypass request (e.g. parameter)
+     * @return true if the effect has to process this block
+     */
+    bool processInput(const juce::AudioBuffer<float>& data, bool bypassed);
+    // true if the effect has to be reset before processing this block (its memory is outdated)
+    bool needsReset(){return m_needsReset;}
+    /**
+     * @brief processOutput replaces the output by the delayed input or the crossfade of both
+     *
+     * @param data output of the effect (or the unprocessed input if the effect did not run)
+     */
+    void processOutput(juce::AudioBuffer<float>& data);
+
+    State getState(){return m_state;}
+
+private:
+    juce::AudioBuffer<float> m_delayLine;
+    int m_delayLength = 1;
+    int m_writePos = 0;
+    int m_latency = 0;
+    int m_maxLatency = 0;
+    int m_numSamples = 0;
+
+    State m_state = State::Active;
+    bool m_needsReset = false;
+    int m_warmupRemaining = 0;
+    int m_fadeLength = 1;
+    int m_fadePos = 0;
+};
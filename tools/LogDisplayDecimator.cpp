@@ -0,0 +1,52 @@
+#include <cmath>
+#include <algorithm>
+
+#include "LogDisplayDecimator.h"
+
+LogDisplayDecimator::LogDisplayDecimator()
+{
+    m_columnStart.fill(0);
+    m_columnEnd.fill(0);
+}
+
+void LogDisplayDecimator::setNumBins(int numBins)
+{
+    m_numBins = numBins;
+    if (numBins < 2)
+    {
+        m_columnStart.fill(0);
+        m_columnEnd.fill(numBins);
+        return;
+    }
+
+    // first bin with log10(i+1)/log10(numBins) >= cc/kNumColumns
+    auto firstBinOfColumn = [numBins](int cc)
+    {
+        double position = std::pow(static_cast<double>(numBins), static_cast<double>(cc) / kNumColumns);
+        return static_cast<int>(std::ceil(position - 1e-9)) - 1;
+    };
+
+    for (auto cc = 0; cc < kNumColumns; ++cc)
+    {
+        int start = std::min(firstBinOfColumn(cc), numBins - 1);
+        int end = cc == kNumColumns - 1 ? numBins : std::min(firstBinOfColumn(cc + 1), numBins);
+        m_columnStart[cc] = start;
+        m_columnEnd[cc] = std::max(end, start + 1);
+    }
+}
+
+void LogDisplayDecimator::process(const float* values, float* minValues, float* maxValues) const
+{
+    for (auto cc = 0; cc < kNumColumns; ++cc)
+    {
+        float minValue = values[m_columnStart[cc]];
+        float maxValue = minValue;
+        for (auto nn = m_columnStart[cc] + 1; nn < m_columnEnd[cc]; ++nn)
+        {
+            minValue = std::min(minValue, values[nn]);
+            maxValue = std::max(maxValue, values[nn]);
+        }
+        minValues[cc] = minValue;
+        maxValues[cc] = maxValue;
+    }
+}
@@ -0,0 +1,43 @@
+/**
+ * @file LogDisplayDecimator.h
+ * @brief reduces a spectrum of N/2+1 bins to a fixed number of log-spaced display columns (min and max per column)
+ * The column of bin i is given by log10(i+1)/log10(numBins), the same mapping the phase plot used per bin.
+ * Columns at low frequencies that contain no bin show the nearest bin above.
+ * Realtime safe: setNumBins and process neither allocate nor lock.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <array>
+
+class LogDisplayDecimator
+{
+public:
+    static constexpr int kNumColumns = 512;
+
+    LogDisplayDecimator();
+    /**
+     * @brief setNumBins computes the bin range of every column
+     *
+     * @param numBins number of bins of the spectrum (N/2+1)
+     */
+    void setNumBins(int numBins);
+    int getNumBins(){return m_numBins;}
+    /**
+     * @brief process writes min and max of the values of every column
+     *
+     * @param values one value per bin (numBins)
+     * @param minValues destination (kNumColumns)
+     * @param maxValues destination (kNumColumns)
+     */
+    void process(const float* values, float* minValues, float* maxValues) const;
+
+private:
+    int m_numBins = 0;
+    // column cc covers the bins m_columnStart[cc] ... m_columnEnd[cc]-1
+    std::array<int, kNumColumns> m_columnStart;
+    std::array<int, kNumColumns> m_columnEnd;
+};
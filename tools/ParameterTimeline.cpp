@@ -0,0 +1,116 @@
+#include "ParameterTimeline.h"
+
+void ParameterTimeline::push(int64_t position, float value)
+{
+    // the oldest point is dropped if the history is full
+    if (m_numPoints == kMaxPoints)
+    {
+        m_first = (m_first + 1) % kMaxPoints;
+        --m_numPoints;
+    }
+    auto& point = m_points[(m_first + m_numPoints) % kMaxPoints];
+    point.position = position;
+    point.value = value;
+    ++m_numPoints;
+}
+
+void ParameterTimeline::record(int64_t position, int numSamples)
+{
+    if (m_param == nullptr)
+        return;
+    float value = m_param->load(std::memory_order_relaxed);
+
+    if (m_numPoints > 0 && position != m_expectedPosition)
+        m_numPoints = 0;
+    m_expectedPosition = position + numSamples;
+
+    if (m_numPoints == 0)
+    {
+        push(position, value);
+        m_lastChanged = false;
+    }
+    else if (value != getLastPoint().value)
+    {
+        // after a constant part, the old value was held until the last host block and the change ramps over that block
+        if (!m_lastChanged && getLastPoint().position < m_lastRecord)
+            push(m_lastRecord, getLastPoint().value);
+
+        // continuous changes in short host blocks: the last point takes the new value
+        if (m_lastChanged && m_numPoints > 1 && position - getLastPoint().position < m_minSpacing)
+            getLastPoint().value = value;
+        else
+            push(position, value);
+        m_lastChanged = true;
+    }
+    else
+    {
+        m_lastChanged = false;
+    }
+    m_lastRecord = position;
+}
+
+float ParameterTimeline::getValueAt(int64_t position) const
+{
+    if (m_numPoints == 0)
+        return m_param != nullptr ? m_param->load(std::memory_order_relaxed) : 0.0f;
+
+    // the newest points are the most likely ones
+    for (int index = m_numPoints - 1; index >= 0; --index)
+    {
+        const auto& point = getPoint(index);
+        if (point.position > position)
+            continue;
+        if (index == m_numPoints - 1)
+            return point.value;
+        const auto& next = getPoint(index + 1);
+        float frac = static_cast<float>(position - point.position) / static_cast<float>(next.position - point.position);
+        return point.value + frac * (next.value - point.value);
+    }
+    return getPoint(0).value;
+}
+
+bool ParameterTimeline::fillRamp(float* destination, int64_t startPosition, int numSamples) const
+{
+    if (numSamples <= 0)
+        return true;
+
+    int64_t endPosition = startPosition + numSamples;
+    // no point inside the block: the value is held
+    if (m_numPoints == 0 || getPoint(m_numPoints - 1).position <= startPosition || getPoint(0).position >= endPosition)
+    {
+        float value = getValueAt(startPosition);
+        for (int nn = 0; nn < numSamples; ++nn)
+            destination[nn] = value;
+        return true;
+    }
+
+    // first point after the start, then walk along the segments
+    int index = 0;
+    while (index < m_numPoints && getPoint(index).position <= startPosition)
+        ++index;
+
+    bool constant = true;
+    float first = getValueAt(startPosition);
+    for (int nn = 0; nn < numSamples; ++nn)
+    {
+        int64_t position = startPosition + nn;
+        while (index < m_numPoints && getPoint(index).position <= position)
+            ++index;
+
+        float value;
+        if (index == 0)
+            value = getPoint(0).value;
+        else if (index == m_numPoints)
+            value = getPoint(m_numPoints - 1).value;
+        else
+        {
+            const auto& point = getPoint(index - 1);
+            const auto& next = getPoint(index);
+            float frac = static_cast<float>(position - point.position) / static_cast<float>(next.position - point.position);
+            value = point.value + frac * (next.value - point.value);
+        }
+        destination[nn] = value;
+        constant = constant && value == first;
+    }
+    return constant;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file ParameterTimeline.h
+ * @brief recent history of a host parameter on the timeline, for block based processing with sample accurate automation
+ * The audio thread records the parameter value at the start of every host block (JUCE hands automation to the
+ * processor as the current parameter value, not as timestamped events). Between two recorded changes the value
+ * is interpolated linearly, a change after a constant part ramps over the host block before it.
+ * A block based effect can then ask for the value at any position of its frame (e.g. its centre) or fill a per
+ * sample ramp over the frame. Fixed size, no allocation; changes closer than minSpacing samples are merged.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+class ParameterTimeline
+{
+public:
+    // enough for a frame of 8192 samples with changes every 64 samples
+    static constexpr int kMaxPoints = 256;
+
+    void prepareParameter(std::atomic<float>* parampointer) { m_param = parampointer; }
+    // merges changes that are closer than this (e.g. tiny host blocks), keeps the history within kMaxPoints
+    void setMinSpacing(int minSpacing) { m_minSpacing = minSpacing > 0 ? minSpacing : 1; }
+
+    /**
+     * @brief record takes the current value of the parameter (audio thread, start of every host block)
+     * a position that does not continue the last block (seek, loop) starts a new history
+     *
+     * @param position timeline position of the first sample of the block
+     * @param numSamples
+     */
+    void record(int64_t position, int numSamples);
+    // value at a timeline position, before the first and after the last point the value is held
+    float getValueAt(int64_t position) const;
+    /**
+     * @brief fillRamp writes the values of [startPosition, startPosition + numSamples)
+     *
+     * @return true if the value is the same for all samples (destination[0])
+     */
+    bool fillRamp(float* destination, int64_t startPosition, int numSamples) const;
+
+private:
+    struct Point
+    {
+        int64_t position = 0;
+        float value = 0.f;
+    };
+    void push(int64_t position, float value);
+    const Point& getPoint(int index) const { return m_points[(m_first + index) % kMaxPoints]; }
+    Point& getLastPoint() { return m_points[(m_first + m_numPoints - 1) % kMaxPoints]; }
+
+    std::atomic<float>* m_param = nullptr;
+    Point m_points[kMaxPoints];
+    int m_first = 0;
+    int m_numPoints = 0;
+    bool m_lastChanged = false; // the last record was a change
+    int64_t m_lastRecord = 0;
+    int64_t m_expectedPosition = 0;
+    int m_minSpacing = 64;
+};
@@ -0,0 +1,195 @@
+#include <cmath>
+#include <algorithm>
+
+#include "PhaseAnalyzer.h"
+
+PhaseAnalyzer::PhaseAnalyzer()
+{
+    m_fifoPre.resize(static_cast<size_t>(m_fifo.getTotalSize()), 0.0f);
+    m_fifoPost.resize(static_cast<size_t>(m_fifo.getTotalSize()), 0.0f);
+    m_inputMix.resize(kMaxPushSize, 0.0f);
+    m_outputMix.resize(kMaxPushSize, 0.0f);
+
+    m_preHistory.resize(kHistorySize, 0.0f);
+    m_postHistory.resize(kHistorySize, 0.0f);
+
+    m_fft.setFFTSize(kFFTSize);
+    m_window.resize(kFFTSize);
+    for (auto nn = 0; nn < kFFTSize; ++nn)
+        m_window[nn] = 0.5f - 0.5f * std::cos(2.0f * juce::MathConstants<float>::pi * nn / kFFTSize);
+    m_fftInput.resize(kFFTSize, 0.0f);
+    m_real.resize(kFFTSize/2+1, 0.0f);
+    m_imag.resize(kFFTSize/2+1, 0.0f);
+    m_prePhase.resize(kFFTSize/2+1, 0.0f);
+    m_postPhase.resize(kFFTSize/2+1, 0.0f);
+    m_decimator.setNumBins(kFFTSize/2+1);
+}
+
+PhaseAnalyzer::~PhaseAnalyzer()
+{
+    m_active.store(false, std::memory_order_release);
+    waitForJob();
+}
+
+void PhaseAnalyzer::addConsumer()
+{
+    if (++m_numConsumers == 1)
+    {
+        m_restart.store(true, std::memory_order_release);
+        m_active.store(true, std::memory_order_release);
+    }
+}
+
+void PhaseAnalyzer::removeConsumer()
+{
+    if (m_numConsumers > 0 && --m_numConsumers == 0)
+        m_active.store(false, std::memory_order_release);
+}
+
+void PhaseAnalyzer::waitForJob()
+{
+    // the audio thread does not submit anymore, a job that is already queued finishes within one hop
+    while (m_jobPending.load(std::memory_order_acquire))
+        juce::Thread::sleep(1);
+}
+
+bool PhaseAnalyzer::isActive() const
+{
+    return m_active.load(std::memory_order_acquire) && m_source.load(std::memory_order_relaxed) != kSourceNone;
+}
+
+float PhaseAnalyzer::getSourceWeight(int source, int channel, int numchns)
+{
+    if (source >= 0)
+        return source == channel ? 1.0f : 0.0f;
+
+    // mid and side of a mono signal is the channel itself
+    if (numchns < 2)
+        return (source == kSourceMid && channel == 0) ? 1.0f : 0.0f;
+
+    if (source == kSourceMid)
+        return channel < 2 ? 0.5f : 0.0f;
+    if (source == kSourceSide)
+        return channel == 0 ? 0.5f : (channel == 1 ? -0.5f : 0.0f);
+    return 0.0f;
+}
+
+void PhaseAnalyzer::mixSource(const juce::AudioBuffer<float>& buffer, int source, float* destination, int numSamples)
+{
+    std::fill(destination, destination + numSamples, 0.0f);
+    int numchns = buffer.getNumChannels();
+    for (auto cc = 0; cc < numchns; ++cc)
+    {
+        float weight = getSourceWeight(source, cc, numchns);
+        if (weight == 0.0f)
+            continue;
+        auto dataPtr = buffer.getReadPointer(cc);
+        for (auto nn = 0; nn < numSamples; ++nn)
+            destination[nn] += weight * dataPtr[nn];
+    }
+}
+
+void PhaseAnalyzer::pushInput(const juce::AudioBuffer<float>& input)
+{
+    m_pushSource = m_source.load(std::memory_order_acquire);
+    m_pushNumSamples = std::min(input.getNumSamples(), kMaxPushSize);
+    mixSource(input, m_pushSource, m_inputMix.data(), m_pushNumSamples);
+}
+
+void PhaseAnalyzer::pushOutput(const juce::AudioBuffer<float>& output)
+{
+    int numSamples = std::min(m_pushNumSamples, output.getNumSamples());
+    mixSource(output, m_pushSource, m_outputMix.data(), numSamples);
+
+    // if the analysis falls behind, the newest samples are dropped
+    numSamples = std::min(numSamples, m_fifo.getFreeSpace());
+    const auto scope = m_fifo.write(numSamples);
+    if (scope.blockSize1 > 0)
+    {
+        std::copy(m_inputMix.begin(), m_inputMix.begin() + scope.blockSize1, m_fifoPre.begin() + scope.startIndex1);
+        std::copy(m_outputMix.begin(), m_outputMix.begin() + scope.blockSize1, m_fifoPost.begin() + scope.startIndex1);
+    }
+    if (scope.blockSize2 > 0)
+    {
+        std::copy(m_inputMix.begin() + scope.blockSize1, m_inputMix.begin() + scope.blockSize1 + scope.blockSize2,
+                  m_fifoPre.begin() + scope.startIndex2);
+        std::copy(m_outputMix.begin() + scope.blockSize1, m_outputMix.begin() + scope.blockSize1 + scope.blockSize2,
+                  m_fifoPost.begin() + scope.startIndex2);
+    }
+
+    // one job at a time, a full pool just delays the analysis to the next block
+    if (m_fifo.getNumReady() >= kHopSize && !m_jobPending.exchange(true, std::memory_order_acq_rel))
+        if (!m_pool->submit(this, WorkerPool::Priority::Background))
+            m_jobPending.store(false, std::memory_order_release);
+}
+
+void PhaseAnalyzer::run()
+{
+    // a new consumer or a new source starts with an empty history
+    if (m_restart.exchange(false, std::memory_order_acq_rel))
+    {
+        m_historyFill = 0;
+        m_samplesSinceFrame = 0;
+        m_lastSource = kSourceNone;
+    }
+
+    // scope of the FIFO read, it is released before the job is marked as done
+    {
+        int source = m_source.load(std::memory_order_acquire);
+        if (source != m_lastSource)
+        {
+            m_historyFill = 0;
+            m_samplesSinceFrame = 0;
+            m_lastSource = source;
+        }
+
+        const auto scope = m_fifo.read(m_fifo.getNumReady());
+        auto append = [this](int start, int size)
+        {
+            for (auto nn = start; nn < start + size; ++nn)
+            {
+                m_preHistory[m_historyWritePos] = m_fifoPre[nn];
+                m_postHistory[m_historyWritePos] = m_fifoPost[nn];
+                m_historyWritePos = (m_historyWritePos + 1) & (kHistorySize - 1);
+            }
+            m_historyFill = std::min(m_historyFill + size, kHistorySize);
+            m_samplesSinceFrame += size;
+        };
+        append(scope.startIndex1, scope.blockSize1);
+        append(scope.startIndex2, scope.blockSize2);
+
+        // only the latest frame is of interest for the display
+        int latency = m_latency.load(std::memory_order_acquire);
+        if (source != kSourceNone && m_samplesSinceFrame >= kHopSize && m_historyFill >= kFFTSize + latency)
+        {
+            computeFrame(source, latency);
+            m_samplesSinceFrame = 0;
+        }
+    }
+
+    // last access to this instance
+    m_jobPending.store(false, std::memory_order_release);
+}
+
+void PhaseAnalyzer::computeFrame(int source, int latency)
+{
+    auto analyse = [this](const std::vector<float>& history, int endPos, std::vector<float>& phase)
+    {
+        int startPos = endPos - kFFTSize;
+        for (auto nn = 0; nn < kFFTSize; ++nn)
+            m_fftInput[nn] = history[(startPos + nn) & (kHistorySize - 1)] * m_window[nn];
+        m_fft.fft(m_fftInput.data(), m_real.data(), m_imag.data());
+        for (auto nn = 0; nn < kFFTSize/2+1; ++nn)
+            phase[nn] = std::atan2(m_imag[nn], m_real[nn]);
+    };
+
+    // the input is delayed by the latency of the processing
+    analyse(m_preHistory, m_historyWritePos - latency, m_prePhase);
+    analyse(m_postHistory, m_historyWritePos, m_postPhase);
+
+    auto& frame = m_frames.getWriteBuffer();
+    frame.source = source;
+    m_decimator.process(m_prePhase.data(), frame.preMin, frame.preMax);
+    m_decimator.process(m_postPhase.data(), frame.postMin, frame.postMax);
+    m_frames.publish();
+}
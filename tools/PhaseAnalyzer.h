@@ -0,0 +1,112 @@
+/**
+ * @file PhaseAnalyzer.h
+ * @brief phase analysis for the display, independent of the processing FFT
+ * The audio thread pushes the input and output samples of the selected source (a channel, mid or side)
+ * into a lock-free FIFO. Once a hop is collected, a background job on the shared worker pool runs its own FFT
+ * (kFFTSize, every kHopSize samples), reduces the phases to log-spaced columns and publishes them through a triple buffer.
+ * The input is delayed by the latency of the processing, so input and output phases belong to the same signal part.
+ * Nothing is pushed or computed while no consumer (e.g. an open editor) is registered.
+ * @version 1.1 (background job on the shared WorkerPool instead of an own thread)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <atomic>
+#include <vector>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_core/juce_core.h>
+
+#include "TripleBuffer.h"
+#include "WorkerPool.h"
+#include "LogDisplayDecimator.h"
+#include "../libs/FFT.h"
+
+class PhaseAnalyzer : private WorkerPool::Job
+{
+public:
+    static constexpr int kFFTSize = 4096;
+    static constexpr int kHopSize = kFFTSize / 4;
+    static constexpr int kMaxLatency = 16384;
+
+    // analysis source: a channel index (0 ... n-1) or one of the following
+    static constexpr int kSourceNone = -1;
+    static constexpr int kSourceMid = -2;
+    static constexpr int kSourceSide = -3;
+
+    // phases before and after processing, reduced to log-spaced columns (min/max)
+    struct Frame
+    {
+        int source = kSourceNone;
+        float preMin[LogDisplayDecimator::kNumColumns] = {};
+        float preMax[LogDisplayDecimator::kNumColumns] = {};
+        float postMin[LogDisplayDecimator::kNumColumns] = {};
+        float postMax[LogDisplayDecimator::kNumColumns] = {};
+    };
+
+    PhaseAnalyzer();
+    ~PhaseAnalyzer() override;
+
+    // all buffers have a fixed size and are allocated in the constructor
+    void setLatency(int latency) { m_latency.store(juce::jlimit(0, kMaxLatency, latency), std::memory_order_release); }
+
+    // message thread: views register while they are on screen, the analysis runs only with consumers
+    void addConsumer();
+    void removeConsumer();
+    void setSource(int source) { m_source.store(source, std::memory_order_release); }
+    // single consumer: true if a new frame is available in getFrame()
+    bool update() { return m_frames.update(); }
+    const Frame& getFrame() const { return m_frames.getReadBuffer(); }
+
+    // audio thread (realtime safe), call pushInput before and pushOutput after the processing of a block,
+    // blocks longer than kMaxPushSize are analysed in part
+    static constexpr int kMaxPushSize = kMaxLatency;
+    bool isActive() const;
+    void pushInput(const juce::AudioBuffer<float>& input);
+    void pushOutput(const juce::AudioBuffer<float>& output);
+
+private:
+    // one analysis step on a pool thread: takes the collected samples and computes the latest frame
+    void run() override;
+    void waitForJob();
+    void computeFrame(int source, int latency);
+    static float getSourceWeight(int source, int channel, int numchns);
+    // weighted sum of the channels of the source
+    static void mixSource(const juce::AudioBuffer<float>& buffer, int source, float* destination, int numSamples);
+
+    std::atomic<int> m_source{kSourceNone};
+    std::atomic<int> m_latency{0};
+    int m_numConsumers = 0; // message thread only
+    std::atomic<bool> m_active{false};
+    std::atomic<bool> m_restart{false};
+    std::atomic<bool> m_jobPending{false};
+    juce::SharedResourcePointer<WorkerPool> m_pool;
+
+    // audio thread -> analysis thread
+    juce::AbstractFifo m_fifo{4 * kMaxLatency};
+    std::vector<float> m_fifoPre;
+    std::vector<float> m_fifoPost;
+    std::vector<float> m_inputMix;
+    std::vector<float> m_outputMix;
+    int m_pushSource = kSourceNone;
+    int m_pushNumSamples = 0;
+
+    // analysis job
+    static constexpr int kHistorySize = 2 * kMaxLatency; // power of two, >= kFFTSize + kMaxLatency
+    std::vector<float> m_preHistory;
+    std::vector<float> m_postHistory;
+    int m_historyWritePos = 0;
+    int m_historyFill = 0;
+    int m_samplesSinceFrame = 0;
+    int m_lastSource = kSourceNone;
+    spectrum m_fft;
+    std::vector<float> m_window;
+    std::vector<float> m_fftInput;
+    std::vector<float> m_real;
+    std::vector<float> m_imag;
+    std::vector<float> m_prePhase;
+    std::vector<float> m_postPhase;
+    LogDisplayDecimator m_decimator;
+    TripleBuffer<Frame> m_frames;
+};
@@ -0,0 +1,125 @@
+#define _USE_MATH_DEFINES
+#include <cmath>
+
+#include "PhaseRandom.h"
+
+namespace
+{
+    const uint32_t kPhiloxM0 = 0xD2511F53u;
+    const uint32_t kPhiloxM1 = 0xCD9E8D57u;
+    const uint32_t kPhiloxW0 = 0x9E3779B9u;
+    const uint32_t kPhiloxW1 = 0xBB67AE85u;
+    const int kPhiloxRounds = 10;
+
+    // 24 bit mantissa mapping to [0,1)
+    inline float toUnitFloat(uint32_t x)
+    {
+        return static_cast<float>(x >> 8) * (1.f / 16777216.f);
+    }
+    // 24 bit mantissa mapping to (0,1], safe for log()
+    inline float toUnitFloatNonZero(uint32_t x)
+    {
+        return static_cast<float>((x >> 8) + 1) * (1.f / 16777216.f);
+    }
+}
+
+PhaseRandom::PhaseRandom(uint64_t seed)
+{
+    setSeed(seed);
+}
+
+void PhaseRandom::setSeed(uint64_t seed)
+{
+    m_seed = seed;
+    m_key0 = static_cast<uint32_t>(seed);
+    m_key1 = static_cast<uint32_t>(seed >> 32);
+}
+
+void PhaseRandom::generate(uint32_t firstGroup, uint32_t channel, int64_t frameIndex)
+{
+    alignas(32) uint32_t c0[kLanes], c1[kLanes], c2[kLanes], c3[kLanes];
+    const uint64_t frame = static_cast<uint64_t>(frameIndex);
+    for (auto ll = 0; ll < kLanes; ++ll)
+    {
+        c0[ll] = firstGroup + static_cast<uint32_t>(ll);
+        c1[ll] = static_cast<uint32_t>(frame);
+        c2[ll] = static_cast<uint32_t>(frame >> 32);
+        c3[ll] = channel;
+    }
+    uint32_t k0 = m_key0;
+    uint32_t k1 = m_key1;
+    for (auto rr = 0; rr < kPhiloxRounds; ++rr)
+    {
+        for (auto ll = 0; ll < kLanes; ++ll)
+        {
+            uint64_t p0 = static_cast<uint64_t>(kPhiloxM0) * c0[ll];
+            uint64_t p1 = static_cast<uint64_t>(kPhiloxM1) * c2[ll];
+            uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1[ll] ^ k0;
+            uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3[ll] ^ k1;
+            c1[ll] = static_cast<uint32_t>(p1);
+            c3[ll] = static_cast<uint32_t>(p0);
+            c0[ll] = n0;
+            c2[ll] = n2;
+        }
+        k0 += kPhiloxW0;
+        k1 += kPhiloxW1;
+    }
+    for (auto ll = 0; ll < kLanes; ++ll)
+    {
+        m_out[0][ll] = c0[ll];
+        m_out[1][ll] = c1[ll];
+        m_out[2][ll] = c2[ll];
+        m_out[3][ll] = c3[ll];
+    }
+}
+
+void PhaseRandom::fillUniform(float* phases, int firstBin, int numBins, uint32_t channel, int64_t frameIndex)
+{
+    const float pi = static_cast<float>(M_PI);
+    const int endBin = firstBin + numBins;
+    // every counter gives 4 words -> 4 bins
+    for (auto kk = (firstBin / 4) * 4; kk < endBin; kk += 4 * kLanes)
+    {
+        generate(static_cast<uint32_t>(kk / 4), channel, frameIndex);
+        for (auto ww = 0; ww < 4; ++ww)
+        {
+            for (auto ll = 0; ll < kLanes; ++ll)
+            {
+                int bin = kk + 4 * ll + ww;
+                if (bin >= firstBin && bin < endBin)
+                    phases[bin] = (toUnitFloat(m_out[ww][ll]) * 2.f - 1.f) * pi;
+            }
+        }
+    }
+}
+
+void PhaseRandom::fillGaussian(float* phases, int firstBin, int numBins, uint32_t channel, int64_t frameIndex, float concentration)
+{
+    const float pi = static_cast<float>(M_PI);
+    const float scale = concentration * pi;
+    const int endBin = firstBin + numBins;
+
+    // every counter gives 2 Box-Muller pairs -> 4 bins
+    for (auto kk = (firstBin / 4) * 4; kk < endBin; kk += 4 * kLanes)
+    {
+        generate(static_cast<uint32_t>(kk / 4), channel, frameIndex);
+        for (auto pp = 0; pp < 2; ++pp)
+        {
+            for (auto ll = 0; ll < kLanes; ++ll)
+            {
+                float radius = std::sqrt(-2.f * std::log(toUnitFloatNonZero(m_out[2*pp][ll]))) * scale;
+                float angle = 2.f * pi * toUnitFloat(m_out[2*pp + 1][ll]);
+                float g1 = radius * std::cos(angle);
+                float g2 = radius * std::sin(angle);
+                g1 = g1 < -pi ? -pi : (g1 > pi ? pi : g1);
+                g2 = g2 < -pi ? -pi : (g2 > pi ? pi : g2);
+
+                int bin = kk + 4 * ll + 2 * pp;
+                if (bin >= firstBin && bin < endBin)
+                    phases[bin] = g1;
+                if (bin + 1 >= firstBin && bin + 1 < endBin)
+                    phases[bin + 1] = g2;
+            }
+        }
+    }
+}
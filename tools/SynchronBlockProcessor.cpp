@@ -13,8 +13,6 @@ SynchronBlockProcessor::SynchronBlockProcessor()
 }
 void SynchronBlockProcessor::prepareSynchronProcessing(int channels, int desiredSize)
 {
-    ScopedLock lock(m_protectBlock);
-    //m_protectBlock.enter();
     m_OutBlockSize = desiredSize;
     m_NrOfChannels = channels;
     m_memory.setSize(m_NrOfChannels,2*m_OutBlockSize);
@@ -29,74 +27,84 @@ void SynchronBlockProcessor::prepareSynchronProcessing(int channels, int desired
         m_directthrue = true;
     else
         m_directthrue = false;
-    //m_protectBlock.exit();
+}
+void SynchronBlockProcessor::resetSynchronProcessing()
+{
+    m_memory.clear();
+    m_block.clear();
+    // the synchron blocks end on multiples of the block size on the timeline, independent of
+    // how many samples were processed before (same boundaries in every render)
+    int offset = 0;
+    if (m_OutBlockSize > 0)
+    {
+        offset = static_cast<int>(m_timelinePosition % m_OutBlockSize);
+        if (offset < 0)
+            offset += m_OutBlockSize;
+    }
+    m_OutCounter = offset;
+    m_InCounter = offset;
+    m_mididata.clear();
+    m_pastSamples = offset;
 }
 void SynchronBlockProcessor::processBlock(juce::AudioBuffer<float>& data, juce::MidiBuffer& midiMessages)
 {
-    ScopedLock lock(m_protectBlock);
     int nrofBlockProcessed = 0;
     if (m_directthrue == true)
     {
+        m_blockEndPosition = m_timelinePosition + data.getNumSamples();
         processSynchronBlock(data, midiMessages, nrofBlockProcessed);
+        m_timelinePosition += data.getNumSamples();
+        return;
     }
-    // m_protectBlock.enter();
     auto readdatapointers = data.getArrayOfReadPointers();
     auto writedatapointers = data.getArrayOfWritePointers();
     int nrOfInputSamples = data.getNumSamples();
-    int nrOfChannels = data.getNumChannels();
+    int nrOfChannels = juce::jmin(data.getNumChannels(), m_NrOfChannels);
+    for (auto cc = nrOfChannels; cc < data.getNumChannels(); ++cc)
+        data.clear(cc, 0, nrOfInputSamples);
     auto blockreaddatapointers = m_block.getArrayOfReadPointers();
     auto blockwritedatapointers = m_block.getArrayOfWritePointers();
     auto memreaddatapointers = m_memory.getArrayOfReadPointers();
     auto memwritedatapointers = m_memory.getArrayOfWritePointers();
 
-    for (auto kk = 0; kk < nrOfInputSamples; ++kk)
+    // segments up to the end of the next synchron block, copied per channel
+    // (m_OutCounter stays in one half of the memory within a segment, it is m_InCounter mod m_OutBlockSize)
+    auto kk = 0;
+    while (kk < nrOfInputSamples)
     {
+        int segmentSize = juce::jmin(nrOfInputSamples - kk, m_OutBlockSize - m_InCounter);
         for (auto cc = 0; cc < nrOfChannels; ++cc)
         {
-            blockwritedatapointers[cc][m_InCounter] = readdatapointers[cc][kk];
-            writedatapointers[cc][kk] = memreaddatapointers[cc][m_OutCounter];
+            juce::FloatVectorOperations::copy(blockwritedatapointers[cc] + m_InCounter, readdatapointers[cc] + kk, segmentSize);
+            juce::FloatVectorOperations::copy(writedatapointers[cc] + kk, memreaddatapointers[cc] + m_OutCounter, segmentSize);
         }
-        m_InCounter++;
+        m_InCounter += segmentSize;
+        m_OutCounter += segmentSize;
+        kk += segmentSize;
+
         if (m_InCounter == m_OutBlockSize)
         {
             m_InCounter = 0;
-            if (kk < m_OutBlockSize)
-                m_mididata.addEvents(midiMessages,0, kk ,m_pastSamples);
+            // last sample of the synchron block
+            auto lastSample = kk - 1;
+            if (lastSample < m_OutBlockSize)
+                m_mididata.addEvents(midiMessages,0, lastSample ,m_pastSamples);
             else
             {
-                m_mididata.addEvents(midiMessages,kk-m_OutBlockSize,m_OutBlockSize,-(kk-m_OutBlockSize));
+                m_mididata.addEvents(midiMessages,lastSample-m_OutBlockSize,m_OutBlockSize,-(lastSample-m_OutBlockSize));
             }
 
+            m_blockEndPosition = m_timelinePosition + kk;
             processSynchronBlock(m_block, m_mididata, nrofBlockProcessed);
             nrofBlockProcessed++;
             m_mididata.clear();
             m_pastSamples = 0;
 
-                // copy block into mem
-            if (m_OutCounter < m_OutBlockSize)
-            {
-                for (auto channel = 0; channel < nrOfChannels; ++channel)
-                {
-                    for (auto sample = 0; sample < m_OutBlockSize; ++sample)
-                    {
-                        memwritedatapointers[channel][sample + m_OutBlockSize] = blockreaddatapointers[channel][sample];
-                    }
-                }
- 
-            }
-            else
-            {
-                for (auto channel = 0; channel < nrOfChannels; ++channel)
-                {
-                    for (auto sample = 0; sample < m_OutBlockSize; ++sample)
-                    {
-                        memwritedatapointers[channel][sample] = blockreaddatapointers[channel][sample];
-                    }
-                }
-            }
-            
+                // copy block into the half of the memory that is read next
+            int memoryOffset = (m_OutCounter <= m_OutBlockSize) ? m_OutBlockSize : 0;
+            for (auto channel = 0; channel < nrOfChannels; ++channel)
+                juce::FloatVectorOperations::copy(memwritedatapointers[channel] + memoryOffset, blockreaddatapointers[channel], m_OutBlockSize);
         }
-        m_OutCounter++;
         if (m_OutCounter == 2*m_OutBlockSize)
             m_OutCounter = 0;
     }
@@ -112,7 +120,7 @@ void SynchronBlockProcessor::processBlock(juce::AudioBuffer<float>& data, juce::
         m_mididata.addEvents(midiMessages,0,nrOfInputSamples,m_pastSamples);
         m_pastSamples += nrOfInputSamples;
     }
-    //m_protectBlock.exit();
+    m_timelinePosition += nrOfInputSamples;
 }
 
 int SynchronBlockProcessor::getDelay()
@@ -246,6 +254,26 @@ int WOLA::prepareWOLAprocessing(int channels, int desiredSize, WOLAType wolalapt
     return 0;
 }
 
+void WOLA::resetWOLAprocessing()
+{
+    m_audioBlock.clear();
+    m_mem50aOut.clear();
+    m_mem50bOut.clear();
+    m_mem50aIn.clear();
+    m_mem50bIn.clear();
+    m_mem25aIn.clear();
+    m_mem25bIn.clear();
+    m_mem25cIn.clear();
+    m_mem25dIn.clear();
+    m_mem25aOut.clear();
+    m_mem25bOut.clear();
+    m_mem25cOut.clear();
+    m_mem25dOut.clear();
+    m_OutCounter = 0;
+    m_InCounter = 0;
+    resetSynchronProcessing();
+}
+
 int WOLA::processSynchronBlock(juce::AudioBuffer<float> &inBlock, juce::MidiBuffer &midiMessages, int NrOfBlocksSinceLastProcessBlock)
 {
     juce::ignoreUnused(NrOfBlocksSinceLastProcessBlock);
@@ -19,6 +19,14 @@
 //
 // Version 2.0 (only JUCE AUdioBUffer, without std::vector)
 // Version 2.1 (added directthrue option and changed CriticalSection to ScopedLock (RAII))
+// Version 2.2 (timeline position of the synchron blocks, e.g. for deterministic processing)
+// Version 2.3 (reset of the memory without reallocation, realtime safe)
+// Version 2.4 (no lock in processBlock anymore, the owner hands reconfigurations to the audio thread, see ConfigEpoch.h)
+// Version 2.5 (number of samples collected for the next synchron block, e.g. to spread work over the callbacks)
+// Version 2.6 (rebuffering in segments per channel instead of sample by sample, for many channels; channels beyond
+//              the prepared ones are cleared)
+// Version 2.7 (timeline position of the next processBlock call, e.g. to timestamp parameter values)
+// Version 2.8 (a reset aligns the synchron blocks to the timeline: they end on multiples of desiredSize)
 
 /* ToDO:
 1) rewrite as template class for double
@@ -34,14 +42,21 @@ public:
     ~SynchronBlockProcessor(){}
     /**
      * @brief preparetoprocess sets the desired blocksize for a given numer of channels
-     * it can be called at any time (threadsafe), but it will cause audio-glitches (not realtime safe)
+     * not realtime safe and not synchronized with processBlock: while the audio thread runs,
+     * call it only inside a reconfiguration of the owner (e.g. ConfigEpoch::ScopedWrite)
      * 
      * @param channels 
      * @param desiredSize 
      */
     void prepareSynchronProcessing(int channels, int desiredSize); 
+    /**
+     * @brief resetSynchronProcessing clears the memory and the counters without reallocation (realtime safe)
+     * call it from the audio thread only (e.g. before processBlock after a pause of the processing)
+     */
+    void resetSynchronProcessing();
     /**
      * @brief the typical JUCE call just forward the call in Processor
+     * data may have any number of channels up to the prepared ones (additional channels are cleared)
      * 
      * @param data 
      * @param midiMessages 
@@ -60,8 +75,33 @@ public:
      * @return int this will be DesiredSize
      */
     int getDelay();
+    /**
+     * @brief setTimelinePosition tells the processor the host position of the first sample of the next processBlock call
+     * if it is never called, the position is counted from the start of processing
+     * 
+     * @param samplePosition 
+     */
+    void setTimelinePosition(int64_t samplePosition){m_timelinePosition = samplePosition;}
+    /**
+     * @brief Get the timeline position of the first sample of the next processBlock call
+     * 
+     * @return int64_t 
+     */
+    int64_t getTimelinePosition(){return m_timelinePosition;}
+    /**
+     * @brief Get the timeline position of the end of the block given to processSynchronBlock
+     * (only valid inside processSynchronBlock)
+     * 
+     * @return int64_t position of the last sample + 1
+     */
+    int64_t getBlockEndPosition(){return m_blockEndPosition;}
+    /**
+     * @brief Get the number of samples already collected for the next synchron block
+     * 
+     * @return int 0 ... desiredSize-1
+     */
+    int getSamplesSinceLastBlock(){return m_InCounter;}
 private:
-    CriticalSection m_protectBlock;
     int m_NrOfChannels;
     int m_OutBlockSize;
     int m_OutCounter;
@@ -73,6 +113,9 @@ private:
     MidiBuffer m_mididata;
     int m_pastSamples;
     bool m_directthrue = false;
+
+    int64_t m_timelinePosition = 0;
+    int64_t m_blockEndPosition = 0;
 };
 
 class WOLA : public SynchronBlockProcessor
@@ -99,6 +142,8 @@ public:
     WOLA();
     ~WOLA();
     int prepareWOLAprocessing(int channels, int desiredSize, WOLAType wolalaptype = WOLAType::NoWin_over50); 
+    // clears all overlap memories without reallocation (realtime safe, audio thread only)
+    void resetWOLAprocessing();
     int processSynchronBlock(juce::AudioBuffer<float>&, juce::MidiBuffer& midiMessages, int NrOfBlocksSinceLastProcessBlock);    
     virtual int processWOLA(juce::AudioBuffer<float>&, juce::MidiBuffer& midiMessages) = 0;
     int getDelay();
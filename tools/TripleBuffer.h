@@ -0,0 +1,60 @@
+/**
+ * @file TripleBuffer.h
+ * @brief wait-free single producer / single consumer triple buffer
+ * The producer (e.g. the audio thread) always owns one buffer to write into, the consumer (e.g. the GUI)
+ * always owns one buffer to read from, the third buffer is exchanged between both with one atomic operation.
+ * Neither side ever waits or allocates; the consumer sees the latest published buffer, older ones are dropped.
+ * Allocate the buffers (forEachBuffer) before both threads run.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <atomic>
+
+template <class T> class TripleBuffer
+{
+public:
+    // producer side
+    T& getWriteBuffer() { return m_buffers[m_writeIndex]; }
+    /**
+     * @brief publish hands the write buffer to the consumer and takes the spare buffer for the next write
+     */
+    void publish()
+    {
+        m_writeIndex = m_spare.exchange(m_writeIndex | kNewDataBit, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    // consumer side
+    /**
+     * @brief update takes the latest published buffer, if there is one
+     *
+     * @return true if getReadBuffer() has new content
+     */
+    bool update()
+    {
+        if ((m_spare.load(std::memory_order_relaxed) & kNewDataBit) == 0)
+            return false;
+        m_readIndex = m_spare.exchange(m_readIndex, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+    const T& getReadBuffer() const { return m_buffers[m_readIndex]; }
+
+    // not thread safe, for setup only
+    template <class F> void forEachBuffer(F&& function)
+    {
+        for (auto& buffer : m_buffers)
+            function(buffer);
+    }
+
+private:
+    static constexpr int kIndexMask = 3;
+    static constexpr int kNewDataBit = 4;
+
+    T m_buffers[3];
+    int m_writeIndex = 0;
+    std::atomic<int> m_spare{1};
+    int m_readIndex = 2;
+};
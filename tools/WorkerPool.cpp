@@ -0,0 +1,234 @@
+#include "WorkerPool.h"
+
+WorkerPool::JobQueue::JobQueue()
+{
+    for (size_t ii = 0; ii < kSize; ++ii)
+        m_cells[ii].sequence.store(ii, std::memory_order_relaxed);
+}
+
+bool WorkerPool::JobQueue::push(Job* job, juce::int64 deadline)
+{
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell& cell = m_cells[pos & (kSize - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0)
+        {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                cell.job = job;
+                cell.deadline.store(deadline, std::memory_order_relaxed);
+                cell.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false; // full
+        }
+        else
+        {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool WorkerPool::JobQueue::pop(Job*& job)
+{
+    size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        Cell& cell = m_cells[pos & (kSize - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+        if (diff == 0)
+        {
+            if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                job = cell.job;
+                cell.sequence.store(pos + kSize, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false; // empty
+        }
+        else
+        {
+            pos = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool WorkerPool::JobQueue::peekDeadline(juce::int64& deadline) const
+{
+    size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    const Cell& cell = m_cells[pos & (kSize - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != pos + 1)
+        return false;
+    deadline = cell.deadline.load(std::memory_order_relaxed);
+    return true;
+}
+
+WorkerPool::Worker::Worker(WorkerPool& pool, int index)
+:juce::Thread("OutOfPhase Worker " + juce::String(index + 1)), m_pool(pool), m_index(index)
+{
+}
+
+void WorkerPool::Worker::wakeUp()
+{
+    m_wakeUp.signal();
+}
+
+void WorkerPool::Worker::run()
+{
+    while (!threadShouldExit())
+    {
+        if (auto* job = m_pool.findJob(m_index))
+        {
+            job->run();
+            continue;
+        }
+
+        // the runs of a parallel frame are submitted together: poll a few microseconds before parking
+        auto spinEnd = juce::Time::getHighResolutionTicks() + m_pool.m_spinTicks;
+        while (!threadShouldExit() && juce::Time::getHighResolutionTicks() < spinEnd)
+        {
+            if (auto* job = m_pool.findJob(m_index))
+            {
+                job->run();
+                spinEnd = juce::Time::getHighResolutionTicks() + m_pool.m_spinTicks;
+            }
+        }
+
+        // pairs with the fence in submit: either the submitter sees m_parked or this search sees the job
+        m_parked.store(true, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (auto* job = m_pool.findJob(m_index))
+        {
+            m_parked.store(false, std::memory_order_seq_cst);
+            job->run();
+            continue;
+        }
+        m_wakeUp.wait(100);
+        m_parked.store(false, std::memory_order_seq_cst);
+    }
+}
+
+WorkerPool::BackgroundWorker::BackgroundWorker(WorkerPool& pool)
+:juce::Thread("OutOfPhase Background"), m_pool(pool)
+{
+}
+
+void WorkerPool::BackgroundWorker::run()
+{
+    // the event stays signalled, a job submitted while the queue is drained is not missed
+    while (!threadShouldExit())
+    {
+        Job* job;
+        while (!threadShouldExit() && m_pool.m_backgroundJobs.pop(job))
+            job->run();
+        m_wakeUp.wait(100);
+    }
+}
+
+WorkerPool::WorkerPool()
+:m_spinTicks(juce::Time::secondsToHighResolutionTicks(kSpinTime_us * 1e-6))
+{
+    int numThreads = juce::jlimit(1, 16, juce::SystemStats::getNumCpus() - 1);
+    for (int ii = 0; ii < numThreads; ++ii)
+        m_workers.push_back(std::make_unique<Worker>(*this, ii));
+
+    for (auto& worker : m_workers)
+        if (!worker->startRealtimeThread(juce::Thread::RealtimeOptions{}.withPriority(9)))
+            worker->startThread(juce::Thread::Priority::highest);
+
+    m_backgroundWorker = std::make_unique<BackgroundWorker>(*this);
+    m_backgroundWorker->startThread(juce::Thread::Priority::normal);
+}
+
+WorkerPool::~WorkerPool()
+{
+    for (auto& worker : m_workers)
+        worker->signalThreadShouldExit();
+    for (auto& worker : m_workers)
+    {
+        worker->wakeUp();
+        worker->stopThread(1000);
+    }
+    m_backgroundWorker->signalThreadShouldExit();
+    m_backgroundWorker->wakeUp();
+    m_backgroundWorker->stopThread(1000);
+}
+
+bool WorkerPool::submit(Job* job, Priority priority, juce::int64 deadlineTicks)
+{
+    if (priority == Priority::Background)
+    {
+        // the event of the background thread latches a wake up, no parked check needed
+        if (!m_backgroundJobs.push(job, 0))
+            return false;
+        m_backgroundWorker->wakeUp();
+        return true;
+    }
+
+    bool queued = false;
+    auto numWorkers = static_cast<unsigned int>(m_workers.size());
+    auto first = m_nextWorker.fetch_add(1, std::memory_order_relaxed);
+    for (unsigned int ii = 0; ii < numWorkers && !queued; ++ii)
+    {
+        auto& worker = *m_workers[(first + ii) % numWorkers];
+        queued = worker.m_realtimeJobs.push(job, deadlineTicks);
+        // the owner of the queue is the best candidate, any other parked worker can steal it;
+        // the fence orders the published slot before the m_parked load (store -> load)
+        if (queued)
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (queued && worker.m_parked.load(std::memory_order_seq_cst))
+            worker.wakeUp();
+    }
+    if (queued)
+        wakeUpOne();
+    return queued;
+}
+
+void WorkerPool::wakeUpOne()
+{
+    for (auto& worker : m_workers)
+    {
+        if (worker->m_parked.load(std::memory_order_seq_cst))
+        {
+            worker->wakeUp();
+            return;
+        }
+    }
+}
+
+WorkerPool::Job* WorkerPool::findJob(int workerIndex)
+{
+    // realtime: the earliest deadline among the queue heads, the own queue wins a tie
+    int numWorkers = static_cast<int>(m_workers.size());
+    int best = -1;
+    juce::int64 bestDeadline = 0;
+    for (int ii = 0; ii < numWorkers; ++ii)
+    {
+        int index = (workerIndex + ii) % numWorkers;
+        juce::int64 deadline;
+        if (m_workers[static_cast<size_t>(index)]->m_realtimeJobs.peekDeadline(deadline)
+            && (best < 0 || deadline < bestDeadline))
+        {
+            best = index;
+            bestDeadline = deadline;
+        }
+    }
+    Job* job = nullptr;
+    if (best >= 0 && m_workers[static_cast<size_t>(best)]->m_realtimeJobs.pop(job))
+        return job;
+    // the head was taken meanwhile: take any other
+    for (int ii = 0; ii < numWorkers; ++ii)
+        if (m_workers[static_cast<size_t>((workerIndex + ii) % numWorkers)]->m_realtimeJobs.pop(job))
+            return job;
+    return nullptr;
+}
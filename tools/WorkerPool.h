@@ -0,0 +1,117 @@
+/**
+ * @file WorkerPool.h
+ * @brief process-wide work-stealing thread pool, shared by all plugin instances
+ * Use it through juce::SharedResourcePointer<WorkerPool>: the first instance creates the pool, the last one
+ * deletes it. The number of threads follows the hardware (number of CPUs - 1, at least one).
+ * Every thread has its own queue of realtime jobs, submit() distributes them round robin and idle threads steal
+ * from the others, the job with the earliest deadline at the queue heads is taken first.
+ * Background jobs (e.g. analysis for the display) run on an own thread with normal priority, the realtime
+ * threads never take them, so they are always free for realtime jobs.
+ * submit() is lock-free and may be called from the audio thread. A job pointer must stay valid until it has run,
+ * realtime jobs must tolerate that their submitter finishes the work itself if the pool is late.
+ * @version 1.1 (background jobs on an own normal priority thread instead of the realtime threads)
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#pragma once
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <juce_core/juce_core.h>
+
+class WorkerPool
+{
+public:
+    enum class Priority
+    {
+        Realtime,
+        Background,
+    };
+
+    struct Job
+    {
+        virtual ~Job() = default;
+        virtual void run() = 0;
+    };
+
+    WorkerPool();
+    ~WorkerPool();
+
+    /**
+     * @brief submit hands a job to the pool (lock-free, any thread)
+     *
+     * @param job
+     * @param priority
+     * @param deadlineTicks absolute deadline (juce::Time::getHighResolutionTicks()) of a realtime job
+     * @return false if all queues are full (the caller runs the job itself or tries again later)
+     */
+    bool submit(Job* job, Priority priority, juce::int64 deadlineTicks = 0);
+    int getNumThreads() const { return static_cast<int>(m_workers.size()); }
+
+private:
+    // bounded lock-free multi producer / multi consumer queue (D. Vyukov)
+    class JobQueue
+    {
+    public:
+        JobQueue();
+        bool push(Job* job, juce::int64 deadline);
+        bool pop(Job*& job);
+        // deadline of the head, false if the queue looks empty (only a hint, the head may change)
+        bool peekDeadline(juce::int64& deadline) const;
+
+    private:
+        static constexpr size_t kSize = 64; // power of two
+        struct Cell
+        {
+            std::atomic<size_t> sequence{0};
+            std::atomic<juce::int64> deadline{0};
+            Job* job = nullptr;
+        };
+        Cell m_cells[kSize];
+        alignas(64) std::atomic<size_t> m_enqueuePos{0};
+        alignas(64) std::atomic<size_t> m_dequeuePos{0};
+    };
+
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(WorkerPool& pool, int index);
+        void run() override;
+        void wakeUp();
+
+        JobQueue m_realtimeJobs;
+        std::atomic<bool> m_parked{false};
+
+    private:
+        WorkerPool& m_pool;
+        int m_index;
+        juce::WaitableEvent m_wakeUp;
+    };
+
+    class BackgroundWorker : public juce::Thread
+    {
+    public:
+        explicit BackgroundWorker(WorkerPool& pool);
+        void run() override;
+        void wakeUp() { m_wakeUp.signal(); }
+
+    private:
+        WorkerPool& m_pool;
+        juce::WaitableEvent m_wakeUp;
+    };
+
+    // next realtime job for the given worker (earliest deadline first)
+    Job* findJob(int workerIndex);
+    void wakeUpOne();
+
+    // a worker without a job polls this long before it parks (bounded by time, not by a count)
+    static constexpr double kSpinTime_us = 5.0;
+    const juce::int64 m_spinTicks;
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    JobQueue m_backgroundJobs;
+    std::unique_ptr<BackgroundWorker> m_backgroundWorker;
+    std::atomic<unsigned int> m_nextWorker{0};
+};